@@ -0,0 +1,715 @@
+/*
+ * File        : concurrent_skip_list_pq.h
+ * Created Date: 2026-10-18 15:37:44
+ * Author      : philma
+ * Desc        : 基于一段连续内存的无锁并发优先队列（Lotan-Shavit），可以放在共享内存中供多个线程/进程同时使用
+ *               插入是无锁的跳跃表插入（Herlihy-Shavit，前向指针的最低位作为删除标记）
+ *               delete_min从头节点沿第0层往后，用CAS抢占节点上的删除标志来逻辑删除，
+ *               抢到后再标记各层指针，并通过一次查找把节点从各层上摘掉
+ *               删除的节点用基于纪元(epoch)的方式回收：每个线程先attach_thread()占用一个线程槽，
+ *               操作时传入槽号；节点在所有线程都离开摘除时的纪元之后，才回到空闲链表中被重用
+ *               相同元素按插入先后排列，先插入的先出队；不支持按位置索引的操作
+ *               对顺序要求不严格时可以用spray_pop()代替delete_min()，分散队首的争抢
+ *               线程槽记录占用进程的pid，进程退出后留下的槽在推进纪元受阻或槽用完时自动释放；
+ *               同一进程内退出的线程没法探测，由其他线程对它的槽调用detach_thread()释放
+ */
+
+#ifndef CONCURRENT_SKIP_LIST_PQ_H
+#define CONCURRENT_SKIP_LIST_PQ_H
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <type_traits>
+#include <cerrno>
+#include <signal.h>
+#include <unistd.h>
+
+template<typename T, typename Compare = std::less<T>>
+class ConcurrentSkipListPQ
+{
+    static const int MAX_LEVEL_NUM = 32;        // 跳跃表的最大层数
+    static const int SKIPLIST_P = 4;            // 跳跃表随机层数，每增加一层的概率，多少分之一
+
+    static_assert(std::is_trivially_copyable<T>::value, "element must be trivially copyable");
+
+public:
+    static const int MAX_THREAD_NUM = 128;      // 最多同时使用的线程数
+    static const uint32_t RETIRE_THRESHOLD = 64;// 线程摘除的节点攒够这么多时，尝试推进纪元并回收
+
+    /*
+     * 初始化，is_raw为false时表示挂接到已经初始化过的内存上
+     * 不能在有其他线程正在使用这段内存时以is_raw=true初始化
+     */
+    bool init(void* mem, size_t mem_size, uint32_t max_len, bool is_raw = true);
+
+    /*
+     * 占用一个线程槽，返回槽号，之后该线程的所有操作都传入这个槽号；槽已用完时先释放已退出进程的槽再试，仍没有时返回-1
+     */
+    int attach_thread();
+
+    /*
+     * 释放线程槽，线程未回收的节点留在槽上，由之后占用该槽的线程继续回收
+     * 占用槽的线程异常退出时，可以由其他线程代为调用，调用者须保证该线程不会再使用这个槽；
+     * 退出时正在插入的节点可能没有接入第0层，这个节点不会再被回收
+     */
+    void detach_thread(int tid);
+
+    /*
+     * 释放所有占用进程已经退出的线程槽，返回释放的槽数
+     * 进程在操作中退出会使纪元停止推进、所有线程都无法回收节点；reclaim遇到这种槽时会自动调用同样的检查
+     * 按pid判断存活，pid被新进程复用时槽不会被释放，只是继续占用，不会误释放活着的槽
+     */
+    int release_dead_slots();
+
+    /*
+     * 插入一个元素，返回false表示插入失败，仅在空间不足的情况下发生
+     */
+    bool insert(const T& element, int tid);
+
+    /*
+     * 取出最小的元素，返回false表示队列为空
+     */
+    bool delete_min(T& element, int tid);
+
+    /*
+     * 松弛的出队（SprayList）：从头节点的较高层开始随机向前跳跃、逐层下降，
+     * 抢占落点附近的元素，取出的是前O(p log³ p)个元素之一，p为并发出队的线程数thread_num
+     * 多个线程不再争抢同一个队首节点，适合对顺序要求不严格的调度场景
+     * 返回false表示队列为空
+     */
+    bool spray_pop(T& element, int tid, int thread_num);
+
+    /*
+     * 队列中的元素个数，有并发操作时只是一个近似值
+     */
+    uint32_t length() const { return __atomic_load_n(&mem_header_->length, __ATOMIC_RELAXED); }
+
+    /*
+     * 根据队列的最大长度，获取需要的最大内存大小
+     * 除了max_len个节点外，还预留了各线程槽等待回收的节点
+     */
+    size_t max_mem_size(uint32_t max_len) const
+    {
+        size_t size = mem_header_size();
+        size += (static_cast<size_t>(max_len) + 1 + MAX_THREAD_NUM * RETIRE_THRESHOLD * 2) * mem_node_size();
+
+        return size;
+    }
+
+    /*
+     * 获取内部的错误信息
+     */
+    const std::string& err_msg() const { return err_msg_; }
+
+private:
+
+    static const uint32_t MAGIC_NUM = 0x12345680;
+    static const size_t MARK_BIT = 1;           // 前向指针的删除标记，节点偏移按8字节对齐，最低位可用
+
+    // 节点的回收状态，插入线程和删除线程谁后完成，谁负责回收节点
+    enum
+    {
+        NODE_LINKING = 1,               // 插入线程还在链接各层
+        NODE_UNLINKED = 2,              // 删除线程已经把节点从各层摘除
+    };
+
+    struct SLThreadSlot
+    {
+        uint32_t in_use;                // 槽是否被占用
+        uint32_t retired_num;           // 已摘除待回收的节点数
+        uint64_t epoch;                 // 线程进入操作时看到的纪元，左移1位，最低位表示是否在操作中
+        size_t retired_list;            // 已摘除待回收的节点列表
+        int32_t pid;                    // 占用槽的进程，为0表示空闲或正在释放
+        char pad[36];                   // 各槽独占一个cache line
+    };
+
+    struct MemHeader
+    {
+        uint32_t magic_num;
+        uint32_t length;                // 队列中的元素个数
+        size_t mem_size;                // 总内存大小
+        size_t alloc_size;              // 已申请大小，包括空闲节点
+        size_t header_size;             // 内存头部大小
+        size_t node_size;               // 节点大小
+        size_t head;                    // 头节点偏移
+        uint64_t free_list;             // 空闲节点列表，高32位是防ABA的版本号，低32位是节点序号加1，为0表示列表为空
+        uint64_t seq;                   // 插入序号，相同元素按序号排列
+        uint64_t epoch;                 // 全局纪元
+        int level_num;                  // 出现过的最大层数，只增不减
+        char pad[52];
+        SLThreadSlot slots[MAX_THREAD_NUM];
+    };
+
+    struct MemNode
+    {
+        T element;                      // 队列中存放的元素
+        uint64_t seq;                   // 插入序号
+        uint64_t retire_epoch;          // 摘除时的纪元
+        size_t next;                    // 空闲列表或者待回收列表中，下一节点的偏移
+        uint32_t deleted;               // 删除标志，delete_min通过CAS抢占
+        uint32_t state;                 // 回收状态
+        int level_num;                  // 节点的层数
+        size_t forward[MAX_LEVEL_NUM];  // 各层的前向指针，最低位为删除标记
+    };
+
+    size_t mem_header_size() const
+    {
+        return (sizeof(MemHeader) + 63) & (~63);
+    }
+
+    size_t mem_node_size() const
+    {
+        return (sizeof(MemNode) + 7) & (~7);
+    }
+
+    MemNode* node_of(size_t ref) const
+    {
+        return reinterpret_cast<MemNode*>(reinterpret_cast<char*>(mem_header_) + ref);
+    }
+
+    static bool is_marked(size_t ref) { return ref & MARK_BIT; }
+    static size_t unmarked(size_t ref) { return ref & ~MARK_BIT; }
+
+    static size_t load(const size_t* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+
+    static bool cas(size_t* p, size_t expected, size_t desired)
+    {
+        return __atomic_compare_exchange_n(p, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    }
+
+    // 节点的先后：先比较元素，元素相同按插入序号
+    bool less(const MemNode* node, const T& element, uint64_t seq) const
+    {
+        Compare cmp;
+        if(cmp(node->element, element)) return true;
+        if(cmp(element, node->element)) return false;
+
+        return node->seq < seq;
+    }
+
+    // random()内部有锁，多线程下用线程各自的xorshift
+    static uint32_t thread_random()
+    {
+        static thread_local uint32_t seed = 0;
+        if(!seed) seed = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&seed)) | 1;
+
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    }
+
+    int random_level() const
+    {
+        int level = 1;
+        while((thread_random() & 0xFFFF) < (1.0 / SKIPLIST_P * 0xFFFF))
+            level += 1;
+
+        return (level < MAX_LEVEL_NUM ? level : MAX_LEVEL_NUM);
+    }
+
+    // 查找每一层上最后一个排在(element, seq)前面的节点及其后继，同时摘掉路过的已标记节点
+    void find(const T& element, uint64_t seq, size_t* preds, size_t* succs);
+
+    // 从curr_ref开始沿第0层往后，抢占第一个未被删除的节点并摘除，返回false表示一直到表尾都没抢到
+    bool claim_from(size_t curr_ref, T& element, int tid);
+
+    // 标记节点各层的前向指针，从高层到低层
+    void mark_levels(MemNode* node);
+
+    // 插入线程或删除线程完成自己的部分，后完成的一方回收节点
+    void finish(size_t node_ref, uint32_t done, int tid);
+
+    void enter(int tid)
+    {
+        uint64_t epoch = __atomic_load_n(&mem_header_->epoch, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&mem_header_->slots[tid].epoch, (epoch << 1) | 1, __ATOMIC_SEQ_CST);
+    }
+
+    // 离开操作，待回收的节点攒够了就尝试回收
+    void leave(int tid)
+    {
+        __atomic_store_n(&mem_header_->slots[tid].epoch, 0, __ATOMIC_RELEASE);
+        if(mem_header_->slots[tid].retired_num >= RETIRE_THRESHOLD)
+            reclaim(tid);
+    }
+
+    // 把已摘除的节点放到线程槽的待回收列表
+    void retire(size_t node_ref, int tid);
+
+    // 尝试推进全局纪元，并回收线程槽上可以回收的节点
+    void reclaim(int tid);
+
+    // 占用槽i的是其他进程且该进程已经退出时，释放这个槽，返回是否释放了
+    bool release_if_dead(int i);
+
+    // 申请一个内存节点，返回节点的偏移；返回0表示内存不够了，申请失败
+    size_t alloc_node();
+
+    // 释放一个内存节点到空闲链表
+    void free_node(size_t node_ref);
+
+private:
+    MemHeader* mem_header_ = nullptr;
+    std::string err_msg_;
+};
+
+template<typename T, typename Compare>
+bool ConcurrentSkipListPQ<T, Compare>::init(void* mem, size_t mem_size, uint32_t max_len, bool is_raw)
+{
+    if(!mem)
+    {
+        err_msg_ = "mem is nullptr";
+        return false;
+    }
+
+    if(mem_size < max_mem_size(max_len))
+    {
+        err_msg_ = "mem_size not enough";
+        return false;
+    }
+
+    size_t header_size = mem_header_size();
+    size_t node_size = mem_node_size();
+    mem_header_ = reinterpret_cast<MemHeader*>(mem);
+    if(!is_raw)
+    {// 做一下简单的校验
+        if(mem_header_->magic_num != MAGIC_NUM || mem_header_->mem_size != mem_size
+            || mem_header_->header_size != header_size || mem_header_->node_size != node_size)
+        {
+            err_msg_ = "mem header check err";
+            return false;
+        }
+    }
+    else
+    {// 初始化内存头，头节点申请后各层都为空
+        memset(mem_header_, 0, header_size);
+
+        mem_header_->mem_size = mem_size;
+        mem_header_->alloc_size = header_size;
+        mem_header_->header_size = header_size;
+        mem_header_->node_size = node_size;
+        mem_header_->free_list = 0;
+        mem_header_->epoch = 1;
+        mem_header_->level_num = 1;
+        mem_header_->head = alloc_node();
+        __atomic_store_n(&mem_header_->magic_num, MAGIC_NUM, __ATOMIC_RELEASE);
+    }
+
+    return true;
+}
+
+template<typename T, typename Compare>
+int ConcurrentSkipListPQ<T, Compare>::attach_thread()
+{
+    for(int round = 0; round < 2; ++round)
+    {
+        for(int i = 0; i < MAX_THREAD_NUM; ++i)
+        {
+            uint32_t expected = 0;
+            if(__atomic_compare_exchange_n(&mem_header_->slots[i].in_use, &expected, 1,
+                false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            {
+                __atomic_store_n(&mem_header_->slots[i].epoch, 0, __ATOMIC_RELEASE);
+                __atomic_store_n(&mem_header_->slots[i].pid, static_cast<int32_t>(getpid()), __ATOMIC_RELEASE);
+                return i;
+            }
+        }
+
+        if(!release_dead_slots()) break;
+    }
+
+    err_msg_ = "no free thread slot";
+    return -1;
+}
+
+template<typename T, typename Compare>
+void ConcurrentSkipListPQ<T, Compare>::detach_thread(int tid)
+{
+    __atomic_store_n(&mem_header_->slots[tid].epoch, 0, __ATOMIC_RELEASE);
+    reclaim(tid);
+    __atomic_store_n(&mem_header_->slots[tid].pid, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&mem_header_->slots[tid].in_use, 0, __ATOMIC_RELEASE);
+}
+
+template<typename T, typename Compare>
+int ConcurrentSkipListPQ<T, Compare>::release_dead_slots()
+{
+    int count = 0;
+    for(int i = 0; i < MAX_THREAD_NUM; ++i)
+    {
+        if(__atomic_load_n(&mem_header_->slots[i].in_use, __ATOMIC_ACQUIRE) && release_if_dead(i))
+            ++count;
+    }
+
+    return count;
+}
+
+template<typename T, typename Compare>
+bool ConcurrentSkipListPQ<T, Compare>::release_if_dead(int i)
+{
+    SLThreadSlot& slot = mem_header_->slots[i];
+    int32_t pid = __atomic_load_n(&slot.pid, __ATOMIC_ACQUIRE);
+    if(!pid || pid == static_cast<int32_t>(getpid())) return false;
+    if(kill(pid, 0) == 0 || errno != ESRCH) return false;
+
+    // 多个进程同时发现时，只有把pid清零成功的一方释放，槽被重新占用前pid一直是0
+    if(!__atomic_compare_exchange_n(&slot.pid, &pid, 0, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        return false;
+
+    // 待回收的节点留在槽上，由之后占用该槽的线程继续回收
+    __atomic_store_n(&slot.epoch, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&slot.in_use, 0, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+template<typename T, typename Compare>
+void ConcurrentSkipListPQ<T, Compare>::find(const T& element, uint64_t seq, size_t* preds, size_t* succs)
+{
+retry:
+    size_t pred_ref = mem_header_->head;
+    for(int i = __atomic_load_n(&mem_header_->level_num, __ATOMIC_ACQUIRE) - 1; i >= 0; --i)
+    {
+        MemNode* pred = node_of(pred_ref);
+        size_t curr_ref = unmarked(load(&pred->forward[i]));
+        while(curr_ref)
+        {
+            MemNode* curr = node_of(curr_ref);
+            size_t succ_ref = load(&curr->forward[i]);
+            while(is_marked(succ_ref))
+            {// curr已被删除，从这一层摘掉；pred也被删除时CAS会失败，从头重来
+                if(!cas(&pred->forward[i], curr_ref, unmarked(succ_ref)))
+                    goto retry;
+
+                curr_ref = unmarked(succ_ref);
+                if(!curr_ref) break;
+
+                curr = node_of(curr_ref);
+                succ_ref = load(&curr->forward[i]);
+            }
+
+            if(!curr_ref || !less(curr, element, seq)) break;
+
+            pred_ref = curr_ref;
+            pred = curr;
+            curr_ref = unmarked(succ_ref);
+        }
+
+        preds[i] = pred_ref;
+        succs[i] = curr_ref;
+    }
+}
+
+template<typename T, typename Compare>
+bool ConcurrentSkipListPQ<T, Compare>::insert(const T& element, int tid)
+{
+    enter(tid);
+
+    size_t new_node_ref = alloc_node();
+    if(!new_node_ref)
+    {// 先回收一下自己槽上的节点再试一次
+        __atomic_store_n(&mem_header_->slots[tid].epoch, 0, __ATOMIC_RELEASE);
+        reclaim(tid);
+        enter(tid);
+        new_node_ref = alloc_node();
+        if(!new_node_ref)
+        {
+            leave(tid);
+            return false;
+        }
+    }
+
+    MemNode* new_node = node_of(new_node_ref);
+    new_node->element = element;
+    new_node->seq = __atomic_fetch_add(&mem_header_->seq, 1, __ATOMIC_RELAXED);
+    new_node->level_num = random_level();
+    new_node->state = NODE_LINKING;
+
+    int level_num = __atomic_load_n(&mem_header_->level_num, __ATOMIC_ACQUIRE);
+    while(new_node->level_num > level_num
+        && !__atomic_compare_exchange_n(&mem_header_->level_num, &level_num, new_node->level_num,
+            false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {}
+
+    size_t preds[MAX_LEVEL_NUM] = {0};
+    size_t succs[MAX_LEVEL_NUM] = {0};
+    for(;;)
+    {
+        find(element, new_node->seq, preds, succs);
+        for(int i = 0; i < new_node->level_num; ++i)
+            __atomic_store_n(&new_node->forward[i], succs[i], __ATOMIC_RELAXED);
+
+        // 链接第0层即完成插入，节点对其他线程可见
+        if(cas(&node_of(preds[0])->forward[0], succs[0], new_node_ref))
+            break;
+    }
+    __atomic_fetch_add(&mem_header_->length, 1, __ATOMIC_RELAXED);
+
+    for(int i = 1; i < new_node->level_num; ++i)
+    {
+        bool linked = false;
+        for(;;)
+        {
+            size_t forward = load(&new_node->forward[i]);
+            if(is_marked(forward)) break;                   // 节点已被删除，不用再链接
+
+            if(forward != succs[i] && !cas(&new_node->forward[i], forward, succs[i]))
+                break;                                      // CAS失败说明节点被标记了
+
+            if(cas(&node_of(preds[i])->forward[i], succs[i], new_node_ref))
+            {
+                linked = true;
+                break;
+            }
+
+            find(element, new_node->seq, preds, succs);
+        }
+
+        if(!linked) break;
+
+        // 链接完成之前节点可能已经被删除，删除线程的查找可能没能摘掉这一层，自己摘一次
+        if(is_marked(load(&new_node->forward[i])))
+        {
+            find(element, new_node->seq, preds, succs);
+            break;
+        }
+    }
+
+    finish(new_node_ref, NODE_LINKING, tid);
+    leave(tid);
+
+    return true;
+}
+
+template<typename T, typename Compare>
+bool ConcurrentSkipListPQ<T, Compare>::delete_min(T& element, int tid)
+{
+    enter(tid);
+
+    MemNode* head = node_of(mem_header_->head);
+    bool ret = claim_from(unmarked(load(&head->forward[0])), element, tid);
+
+    leave(tid);
+    return ret;
+}
+
+template<typename T, typename Compare>
+bool ConcurrentSkipListPQ<T, Compare>::spray_pop(T& element, int tid, int thread_num)
+{
+    // 跳跃落点偏向高层节点，只靠跳跃的话，表头会积累一段抢不到的低层节点，使查找退化
+    // 所以有1/p的概率直接从表头出队，清理表头，对表头的争抢仍然降低为原来的1/p
+    if(thread_num <= 1 || thread_random() % thread_num == 0) return delete_min(element, tid);
+
+    // 参数按SprayList论文取，层数按SKIPLIST_P为底换算：起始高度H = log_P(p) + 1，每层随机前进[0, L]步，L = log2(p) + 1
+    int log_p = 0;
+    while((1 << (log_p + 1)) <= thread_num) ++log_p;
+
+    int log_level = 0;
+    while((1 << (log_level + 1)) <= SKIPLIST_P) ++log_level;
+
+    int height = (log_p + log_level - 1) / log_level + 1;
+    int jump = log_p + 1;
+
+    enter(tid);
+
+    int level_num = __atomic_load_n(&mem_header_->level_num, __ATOMIC_ACQUIRE);
+    if(height > level_num) height = level_num;
+
+    size_t node_ref = mem_header_->head;
+    for(int i = height - 1; i >= 0; --i)
+    {
+        int steps = thread_random() % (jump + 1);
+        for(int s = 0; s < steps; ++s)
+        {
+            size_t forward = unmarked(load(&node_of(node_ref)->forward[i]));
+            if(!forward) break;
+
+            node_ref = forward;
+        }
+    }
+
+    // 落点是头节点时从第一个节点开始抢；落点之后都被抢完了，退回到从头开始
+    size_t start_ref = node_ref;
+    if(start_ref == mem_header_->head)
+        start_ref = unmarked(load(&node_of(start_ref)->forward[0]));
+
+    bool ret = claim_from(start_ref, element, tid);
+    if(!ret && node_ref != mem_header_->head)
+        ret = claim_from(unmarked(load(&node_of(mem_header_->head)->forward[0])), element, tid);
+
+    leave(tid);
+    return ret;
+}
+
+template<typename T, typename Compare>
+bool ConcurrentSkipListPQ<T, Compare>::claim_from(size_t curr_ref, T& element, int tid)
+{
+    while(curr_ref)
+    {
+        MemNode* curr = node_of(curr_ref);
+        uint32_t expected = 0;
+        if(__atomic_load_n(&curr->deleted, __ATOMIC_RELAXED) == 0
+            && __atomic_compare_exchange_n(&curr->deleted, &expected, 1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        {
+            element = curr->element;
+            __atomic_fetch_sub(&mem_header_->length, 1, __ATOMIC_RELAXED);
+
+            mark_levels(curr);
+            size_t preds[MAX_LEVEL_NUM] = {0};
+            size_t succs[MAX_LEVEL_NUM] = {0};
+            find(curr->element, curr->seq, preds, succs);
+
+            finish(curr_ref, NODE_UNLINKED, tid);
+            return true;
+        }
+
+        curr_ref = unmarked(load(&curr->forward[0]));
+    }
+
+    return false;
+}
+
+template<typename T, typename Compare>
+void ConcurrentSkipListPQ<T, Compare>::mark_levels(MemNode* node)
+{
+    for(int i = node->level_num - 1; i >= 0; --i)
+    {
+        size_t forward = load(&node->forward[i]);
+        while(!is_marked(forward) && !cas(&node->forward[i], forward, forward | MARK_BIT))
+            forward = load(&node->forward[i]);
+    }
+}
+
+template<typename T, typename Compare>
+void ConcurrentSkipListPQ<T, Compare>::finish(size_t node_ref, uint32_t done, int tid)
+{
+    MemNode* node = node_of(node_ref);
+    uint32_t state = __atomic_load_n(&node->state, __ATOMIC_ACQUIRE);
+    uint32_t desired = 0;
+    do
+    {// 插入线程完成时清掉NODE_LINKING，删除线程完成时设置NODE_UNLINKED
+        desired = done == NODE_LINKING ? (state & ~NODE_LINKING) : (state | NODE_UNLINKED);
+    } while(!__atomic_compare_exchange_n(&node->state, &state, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    if(desired == NODE_UNLINKED)
+    {
+        if(done == NODE_LINKING)
+        {// 删除线程先完成了，它的查找可能早于自己最后一层的链接，再摘一次
+            size_t preds[MAX_LEVEL_NUM] = {0};
+            size_t succs[MAX_LEVEL_NUM] = {0};
+            find(node->element, node->seq, preds, succs);
+        }
+
+        retire(node_ref, tid);
+    }
+}
+
+template<typename T, typename Compare>
+void ConcurrentSkipListPQ<T, Compare>::retire(size_t node_ref, int tid)
+{
+    SLThreadSlot& slot = mem_header_->slots[tid];
+    MemNode* node = node_of(node_ref);
+    node->retire_epoch = __atomic_load_n(&mem_header_->epoch, __ATOMIC_SEQ_CST);
+    node->next = slot.retired_list;
+    slot.retired_list = node_ref;
+    slot.retired_num += 1;
+}
+
+template<typename T, typename Compare>
+void ConcurrentSkipListPQ<T, Compare>::reclaim(int tid)
+{
+    // 所有在操作中的线程都已经看到当前纪元时，纪元才能往前推进
+    uint64_t epoch = __atomic_load_n(&mem_header_->epoch, __ATOMIC_SEQ_CST);
+    bool all_seen = true;
+    for(int i = 0; i < MAX_THREAD_NUM && all_seen; ++i)
+    {
+        uint64_t slot_epoch = __atomic_load_n(&mem_header_->slots[i].epoch, __ATOMIC_SEQ_CST);
+        if((slot_epoch & 1) && (slot_epoch >> 1) != epoch && !release_if_dead(i))
+            all_seen = false;
+    }
+
+    if(all_seen && __atomic_compare_exchange_n(&mem_header_->epoch, &epoch, epoch + 1,
+        false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+    {
+        epoch += 1;
+    }
+
+    // 摘除后纪元推进了两次，摘除时在操作中的线程都已经离开，节点可以重用
+    SLThreadSlot& slot = mem_header_->slots[tid];
+    size_t* prev = &slot.retired_list;
+    while(*prev)
+    {
+        size_t node_ref = *prev;
+        MemNode* node = node_of(node_ref);
+        if(node->retire_epoch + 2 <= epoch)
+        {
+            *prev = node->next;
+            slot.retired_num -= 1;
+            free_node(node_ref);
+        }
+        else
+            prev = &node->next;
+    }
+}
+
+template<typename T, typename Compare>
+size_t ConcurrentSkipListPQ<T, Compare>::alloc_node()
+{
+    size_t pos = 0;
+    uint64_t free_list = __atomic_load_n(&mem_header_->free_list, __ATOMIC_ACQUIRE);
+    while(free_list & 0xFFFFFFFF)
+    {// 空闲链表非空，从空闲链表上申请节点
+        // 读到的next可能已经被别的线程申请走并改写，此时版本号变了，CAS会失败
+        size_t node_ref = mem_header_->header_size + ((free_list & 0xFFFFFFFF) - 1) * mem_header_->node_size;
+        size_t next = __atomic_load_n(&node_of(node_ref)->next, __ATOMIC_RELAXED);
+        uint64_t next_index = next ? (next - mem_header_->header_size) / mem_header_->node_size + 1 : 0;
+        uint64_t desired = ((free_list >> 32) + 1) << 32 | next_index;
+        if(__atomic_compare_exchange_n(&mem_header_->free_list, &free_list, desired,
+            false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            pos = node_ref;
+            break;
+        }
+    }
+
+    if(!pos)
+    {// 空闲链表为空，从未使用的内存中申请节点
+        size_t alloc_size = __atomic_load_n(&mem_header_->alloc_size, __ATOMIC_RELAXED);
+        while(alloc_size + mem_header_->node_size <= mem_header_->mem_size)
+        {
+            if(__atomic_compare_exchange_n(&mem_header_->alloc_size, &alloc_size, alloc_size + mem_header_->node_size,
+                false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            {
+                pos = alloc_size;
+                break;
+            }
+        }
+    }
+
+    if(pos) memset(node_of(pos), 0, mem_header_->node_size);
+
+    return pos;
+}
+
+template<typename T, typename Compare>
+void ConcurrentSkipListPQ<T, Compare>::free_node(size_t node_ref)
+{
+    MemNode* node = node_of(node_ref);
+    uint64_t index = (node_ref - mem_header_->header_size) / mem_header_->node_size + 1;
+    uint64_t free_list = __atomic_load_n(&mem_header_->free_list, __ATOMIC_ACQUIRE);
+    uint64_t desired = 0;
+    do
+    {
+        uint64_t head_index = free_list & 0xFFFFFFFF;
+        size_t next = head_index ? mem_header_->header_size + (head_index - 1) * mem_header_->node_size : 0;
+        __atomic_store_n(&node->next, next, __ATOMIC_RELAXED);
+        desired = ((free_list >> 32) + 1) << 32 | index;
+    } while(!__atomic_compare_exchange_n(&mem_header_->free_list, &free_list, desired,
+        false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+}
+
+#endif
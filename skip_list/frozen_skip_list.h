@@ -0,0 +1,261 @@
+/*
+ * File        : frozen_skip_list.h
+ * Created Date: 2026-10-18 21:32:48
+ * Author      : philma
+ * Desc        : 跳跃表冻结后的只读视图，内存中没有任何指针和偏移，可以直接拷贝、映射到任意地址使用
+ *               布局：头部 | 有序元素数组 | 采样索引（Eytzinger顺序） | 采样在元素数组中的位置
+ *               每SAMPLE_STRIDE个元素取一个采样，采样按Eytzinger（BFS）顺序存放，查找时先在采样上做无分支的下降，
+ *               并提前预取几层之后的节点，定位到一个采样区间后再在区间内做无分支的二分
+ *               位置索引就是元素在数组中的下标加1，按位置索引查找是O(1)
+ *               由SkipList::freeze_to生成，元素须能按字节拷贝
+ */
+
+#ifndef FROZEN_SKIP_LIST_H
+#define FROZEN_SKIP_LIST_H
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+
+template<typename T, typename Compare = std::less<T>>
+class FrozenSkipList
+{
+    static_assert(std::is_trivially_copyable<T>::value, "frozen element must be trivially copyable");
+
+public:
+    static const uint32_t SAMPLE_STRIDE = 16;   // 每隔多少个元素取一个采样
+
+    typedef const T* Iterator;
+
+    /*
+     * 冻结length个元素需要的内存大小
+     */
+    static size_t mem_size_of(uint32_t length)
+    {
+        uint32_t sample_num = (length + SAMPLE_STRIDE - 1) / SAMPLE_STRIDE;
+        size_t size = align(sizeof(FrozenHeader));
+        size += align(sizeof(T) * length);
+        size += align(sizeof(T) * (sample_num + 1));
+        size += align(sizeof(uint32_t) * (sample_num + 1));
+
+        return size;
+    }
+
+    /*
+     * 把[first, first + length)的有序元素写成冻结布局，空间不足时返回false
+     */
+    template<typename InputIt>
+    static bool build(InputIt first, uint32_t length, void* mem, size_t mem_size);
+
+    /*
+     * 挂接到冻结布局上，只读
+     */
+    bool init(const void* mem, size_t mem_size);
+
+    /*
+     * 查找元素的位置索引（如果有多个相同元素，取排在最前面元素的位置），索引值从1开始，返回0表示没找到
+     */
+    uint32_t get_index(const T& element) const { return get_index_of(element); }
+
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    uint32_t get_index(const K& key) const { return get_index_of(key); }
+
+    /*
+     * 根据元素查找，返回第一个相同元素的迭代器，找不到则返回end
+     */
+    Iterator find(const T& element) const { return find_of(element); }
+
+    template<typename K, typename C = Compare,
+        typename = typename std::enable_if<!std::is_integral<K>::value, typename C::is_transparent>::type>
+    Iterator find(const K& key) const { return find_of(key); }
+
+    /*
+     * 根据位置索引查找，位置索引从1开始，不在[1, length]范围内时返回end
+     */
+    Iterator find(uint32_t index) const
+    {
+        if(index == 0 || index > header_->length) return end();
+
+        return keys_ + index - 1;
+    }
+
+    /*
+     * 查找第一个不小于element的元素，没有则返回end
+     */
+    Iterator lower_bound(const T& element) const { return keys_ + lower_pos(element); }
+
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    Iterator lower_bound(const K& key) const { return keys_ + lower_pos(key); }
+
+    uint32_t length() const { return header_->length; }
+
+    Iterator begin() const { return keys_; }
+
+    Iterator end() const { return keys_ + header_->length; }
+
+    const std::string& err_msg() const { return err_msg_; }
+
+private:
+
+    static const uint32_t MAGIC_NUM = 0x46524F5A;
+
+    struct FrozenHeader
+    {
+        uint32_t magic_num;
+        uint32_t elem_size;             // 元素大小，挂接时校验
+        uint32_t length;                // 元素个数
+        uint32_t sample_num;            // 采样个数
+        size_t mem_size;                // 冻结布局的总大小
+    };
+
+    // 各部分按缓存行对齐
+    static size_t align(size_t size) { return (size + 63) & (~static_cast<size_t>(63)); }
+
+    // 按中序把采样填到Eytzinger数组里，k为Eytzinger下标（从1开始），i为下一个采样的序号
+    static uint32_t fill(T* samples, uint32_t* positions, const T* keys, uint32_t sample_num, uint32_t k, uint32_t i)
+    {
+        if(k > sample_num) return i;
+
+        i = fill(samples, positions, keys, sample_num, 2 * k, i);
+        samples[k] = keys[i * SAMPLE_STRIDE];
+        positions[k] = i * SAMPLE_STRIDE;
+        ++i;
+
+        return fill(samples, positions, keys, sample_num, 2 * k + 1, i);
+    }
+
+    // 第一个不小于key的元素在数组中的下标，都小于key时返回length
+    template<typename K>
+    uint32_t lower_pos(const K& key) const;
+
+    template<typename K>
+    uint32_t get_index_of(const K& key) const
+    {
+        uint32_t pos = lower_pos(key);
+        if(pos == header_->length || Compare()(key, keys_[pos])) return 0;
+
+        return pos + 1;
+    }
+
+    template<typename K>
+    Iterator find_of(const K& key) const
+    {
+        uint32_t pos = lower_pos(key);
+        if(pos == header_->length || Compare()(key, keys_[pos])) return end();
+
+        return keys_ + pos;
+    }
+
+private:
+    const FrozenHeader* header_ = nullptr;
+    const T* keys_ = nullptr;
+    const T* samples_ = nullptr;                // 下标从1开始
+    const uint32_t* positions_ = nullptr;       // 下标从1开始
+    std::string err_msg_;
+};
+
+template<typename T, typename Compare>
+template<typename InputIt>
+bool FrozenSkipList<T, Compare>::build(InputIt first, uint32_t length, void* mem, size_t mem_size)
+{
+    if(!mem || mem_size < mem_size_of(length)) return false;
+
+    uint32_t sample_num = (length + SAMPLE_STRIDE - 1) / SAMPLE_STRIDE;
+    char* base = reinterpret_cast<char*>(mem);
+    FrozenHeader* header = reinterpret_cast<FrozenHeader*>(base);
+    T* keys = reinterpret_cast<T*>(base + align(sizeof(FrozenHeader)));
+    T* samples = reinterpret_cast<T*>(reinterpret_cast<char*>(keys) + align(sizeof(T) * length));
+    uint32_t* positions = reinterpret_cast<uint32_t*>(reinterpret_cast<char*>(samples) + align(sizeof(T) * (sample_num + 1)));
+
+    memset(header, 0, sizeof(FrozenHeader));
+    header->magic_num = MAGIC_NUM;
+    header->elem_size = sizeof(T);
+    header->length = length;
+    header->sample_num = sample_num;
+    header->mem_size = mem_size_of(length);
+
+    for(uint32_t i = 0; i < length; ++i, ++first)
+        keys[i] = *first;
+
+    memset(static_cast<void*>(samples), 0, sizeof(T));
+    positions[0] = 0;
+    fill(samples, positions, keys, sample_num, 1, 0);
+
+    return true;
+}
+
+template<typename T, typename Compare>
+bool FrozenSkipList<T, Compare>::init(const void* mem, size_t mem_size)
+{
+    if(!mem)
+    {
+        err_msg_ = "mem is nullptr";
+        return false;
+    }
+
+    const FrozenHeader* header = reinterpret_cast<const FrozenHeader*>(mem);
+    if(mem_size < sizeof(FrozenHeader) || header->magic_num != MAGIC_NUM || header->elem_size != sizeof(T)
+        || header->mem_size > mem_size || header->mem_size != mem_size_of(header->length))
+    {
+        err_msg_ = "frozen header check err";
+        return false;
+    }
+
+    const char* base = reinterpret_cast<const char*>(mem);
+    header_ = header;
+    keys_ = reinterpret_cast<const T*>(base + align(sizeof(FrozenHeader)));
+    samples_ = reinterpret_cast<const T*>(reinterpret_cast<const char*>(keys_) + align(sizeof(T) * header->length));
+    positions_ = reinterpret_cast<const uint32_t*>(reinterpret_cast<const char*>(samples_)
+        + align(sizeof(T) * (header->sample_num + 1)));
+
+    return true;
+}
+
+template<typename T, typename Compare>
+template<typename K>
+uint32_t FrozenSkipList<T, Compare>::lower_pos(const K& key) const
+{
+    Compare cmp;
+    uint32_t sample_num = header_->sample_num;
+
+    // 在采样上下降，每个缓存行的后代在4层之后，提前预取
+    uint32_t k = 1;
+    while(k <= sample_num)
+    {
+        __builtin_prefetch(samples_ + 16 * k);
+        k = 2 * k + cmp(samples_[k], key);
+    }
+    // 去掉最后连续向右的步数，得到第一个不小于key的采样，都小于key时k为0
+    k >>= __builtin_ffs(~k);
+
+    uint32_t lo = 0;
+    uint32_t hi = 0;
+    if(k)
+    {// 前一个采样小于key，结果在(前一个采样, 这个采样]之间
+        hi = positions_[k];
+        lo = hi ? hi - SAMPLE_STRIDE + 1 : 0;
+    }
+    else
+    {// 结果在最后一个采样之后
+        hi = header_->length;
+        lo = sample_num ? (sample_num - 1) * SAMPLE_STRIDE + 1 : 0;
+    }
+
+    // 在[lo, hi)中做无分支二分，都小于key时结果为hi
+    const T* base = keys_ + lo;
+    uint32_t n = hi - lo;
+    while(n > 1)
+    {
+        uint32_t half = n / 2;
+        base = cmp(base[half], key) ? base + half : base;
+        n -= half;
+    }
+
+    if(n == 1 && cmp(*base, key)) ++base;
+
+    return static_cast<uint32_t>(base - keys_);
+}
+
+#endif
@@ -0,0 +1,579 @@
+/*
+ * File        : multi_index_skip_list.h
+ * Created Date: 2026-10-18 13:05:52
+ * Author      : philma
+ * Desc        : 基于一段连续内存的多索引跳跃表，同一份元素按多种排序方式组织
+ *               每个元素节点上，每种排序各有一套层（前向指针、跨度、后向指针），元素本身只存一份
+ *               一次插入/删除同时维护所有排序，各排序分别支持按元素查找、按位置索引查找和迭代器遍历
+ *               排序方式由模板参数Compares给出，接口中的模板参数I表示第几种排序，从0开始
+ */
+
+#ifndef MULTI_INDEX_SKIP_LIST_H
+#define MULTI_INDEX_SKIP_LIST_H
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <tuple>
+#include <type_traits>
+
+template<typename T, typename... Compares>
+class MultiIndexSkipList
+{
+    static const int MAX_LEVEL_NUM = 32;        // 跳跃表的最大层数
+    static const int SKIPLIST_P = 4;            // 跳跃表随机层数，每增加一层的概率，多少分之一
+    static const int INDEX_NUM = sizeof...(Compares);
+
+    static_assert(INDEX_NUM > 0, "at least one Compare is required");
+
+public:
+    template<int I> class Iterator;
+
+    template<int I>
+    using IndexCompare = typename std::tuple_element<I, std::tuple<Compares...>>::type;
+
+    /*
+     * 初始化跳跃表
+     */
+    bool init(void* mem, size_t mem_size, uint32_t max_sl_len, bool is_raw = true);
+
+    /*
+     * 在第I种排序中查找元素的位置索引（如果有多个相同元素，取排在最前面元素的位置），索引值从1开始
+     * 返回0表示没找到
+     */
+    template<int I>
+    uint32_t get_index(const T& element) const;
+
+    /*
+     * 在第I种排序中查找元素，返回元素所在位置的迭代器（如果有多个相同元素，取排在最前面元素的位置）
+     * 找不到则返回迭代器同end<I>函数
+     */
+    template<int I>
+    Iterator<I> find(const T& element) const;
+
+    /*
+     * 根据第I种排序中的位置索引查找，位置索引从1开始
+     * 不在[1, length]范围内的索引，返回迭代器同end<I>函数
+     */
+    template<int I>
+    Iterator<I> find(uint32_t index) const;
+
+    /*
+     * 插入一个元素，同时加入所有排序，每种排序中，相同元素按节点在内存中的偏移从小到大排列，与插入顺序无关
+     * 返回false表示插入失败，仅在空间不足的情况下发生
+     */
+    bool insert(const T& element);
+
+    /*
+     * 删除在第I种排序下和element相同的所有元素，同时从所有排序中摘除
+     * 返回删除的元素个数
+     */
+    template<int I>
+    uint32_t erase(const T& element);
+
+    /*
+     * 当前元素个数
+     */
+    uint32_t length() const { return mem_header_->length; }
+
+    /*
+     * 根据跳跃表的最大长度，获取需要的最大内存大小
+     */
+    size_t max_mem_size(uint32_t max_sl_len) const
+    {
+        size_t size = mem_header_size();
+        size += (max_sl_len + 1) * mem_node_size();
+
+        return size;
+    }
+
+    /*
+     * 获取跳跃表内部的错误信息
+     */
+    const std::string& err_msg() const { return err_msg_; }
+
+    template<int I>
+    Iterator<I> begin() const
+    {
+        MemNode* node = reinterpret_cast<MemNode*>(deref(mem_header_->head));
+        return Iterator<I>(this, node->tower[I].level[0].forward);
+    }
+
+    template<int I>
+    Iterator<I> end() const
+    {
+        return Iterator<I>(this, 0);
+    }
+
+public:
+
+    template<int I>
+    class Iterator
+    {
+    public:
+        Iterator(const MultiIndexSkipList* skip_list_, size_t node_ref_)
+            :skip_list(skip_list_), node_ref(node_ref_)
+        {}
+
+        const T& operator*() const
+        {
+            MemNode* node = reinterpret_cast<MemNode*>(skip_list->deref(node_ref));
+            return node->element;
+        }
+
+        const T* operator->() const
+        {
+            MemNode* node = reinterpret_cast<MemNode*>(skip_list->deref(node_ref));
+            return &(node->element);
+        }
+
+        bool operator==(const Iterator& rhs) const
+        {
+            return (skip_list == rhs.skip_list
+                && node_ref == rhs.node_ref);
+        }
+
+        bool operator!=(const Iterator& rhs) const
+        {
+            return (skip_list != rhs.skip_list
+                || node_ref != rhs.node_ref);
+        }
+
+        Iterator& operator++()
+        {
+            MemNode* node = reinterpret_cast<MemNode*>(skip_list->deref(node_ref));
+            node_ref = node->tower[I].level[0].forward;
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            Iterator tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        Iterator& operator--()
+        {
+            MemNode* node = reinterpret_cast<MemNode*>(skip_list->deref(node_ref));
+            node_ref = node->tower[I].backword;
+            return *this;
+        }
+
+        Iterator operator--(int)
+        {
+            Iterator tmp = *this;
+            --(*this);
+            return tmp;
+        }
+
+    private:
+        const MultiIndexSkipList* skip_list;
+        size_t node_ref;
+    };
+
+private:
+
+    static const uint32_t MAGIC_NUM = 0x12345679;
+
+    struct SLInfo
+    {
+        size_t tail;                    // 跳跃表尾节点偏移
+        int level_num;                  // 跳跃表当前的层数
+    };
+
+    struct SLLevel
+    {
+        size_t forward;                 // 指向跳到的下一个跳跃表节点
+        uint32_t span;                  // 跳跃的跨度
+    };
+
+    // 节点在一种排序中的层
+    struct SLTower
+    {
+        size_t backword;                // 指向前一个跳跃表节点，用于逆向遍历
+        int level_num;                  // 节点在这种排序中的层数，摘除节点时用于确定前驱
+        SLLevel level[MAX_LEVEL_NUM];   // 跳跃表节点中的层
+    };
+
+    struct MemHeader
+    {
+        uint32_t magic_num;
+        size_t mem_size;                // 总内存大小
+        size_t alloc_size;              // 已申请大小，包括空闲节点
+        size_t header_size;             // 内存头部大小
+        size_t node_size;               // 节点大小
+        size_t free_list;               // 空闲节点列表，为0表示列表为空
+        size_t head;                    // 头节点偏移，各排序共用
+        uint32_t length;                // 当前的长度，即元素个数
+        SLInfo sl_info[INDEX_NUM];      // 各排序的信息
+    };
+
+    struct MemNode
+    {
+        T element;                      // 跳跃表中存放的元素
+        SLTower tower[INDEX_NUM];       // 各排序的层
+        size_t next;                    // 空闲列表中，下一节点的偏移
+    };
+
+    template<int I>
+    using IndexTag = std::integral_constant<int, I>;
+
+    size_t mem_header_size() const
+    {
+        return (sizeof(MemHeader) + 7) & (~7);
+    }
+
+    size_t mem_node_size() const
+    {
+        return (sizeof(MemNode) + 7) & (~7);
+    }
+
+    size_t ref(void* p) const
+    {
+        return reinterpret_cast<char*>(p) - reinterpret_cast<char*>(mem_header_);
+    }
+
+    void* deref(size_t ref) const
+    {
+        return reinterpret_cast<char*>(mem_header_) + ref;
+    }
+
+    int random_level() const
+    {
+        int level = 1;
+        while((random() & 0xFFFF) < (1.0 / SKIPLIST_P * 0xFFFF))
+            level += 1;
+
+        return (level < MAX_LEVEL_NUM ? level : MAX_LEVEL_NUM);
+    }
+
+    // 在第I种排序中，查找每一层上最后一个排在(element, node_ref)前面的节点，记录到update，返回第0层上的该节点
+    // 相同元素按节点偏移排序，node_ref为0时即最后一个小于element的节点
+    template<int I>
+    MemNode* find_update(const T& element, size_t* update, uint32_t* index, size_t node_ref = 0) const;
+
+    // 把节点链接进第I种排序，以及之后的所有排序
+    template<int I>
+    void link_from(size_t node_ref, IndexTag<I>);
+    void link_from(size_t, IndexTag<INDEX_NUM>) {}
+
+    // 把节点从第I种排序，以及之后的所有排序中摘除
+    template<int I>
+    void unlink_from(size_t node_ref, IndexTag<I>);
+    void unlink_from(size_t, IndexTag<INDEX_NUM>) {}
+
+    // 申请一个内存节点，返回节点的偏移；返回0表示内存不够了，申请失败
+    size_t alloc_node();
+
+    // 释放一个内存节点到空闲链表
+    void free_node(size_t node_ref);
+
+private:
+    MemHeader* mem_header_ = nullptr;
+    std::string err_msg_;
+};
+
+template<typename T, typename... Compares>
+bool MultiIndexSkipList<T, Compares...>::init(void* mem, size_t mem_size, uint32_t max_sl_len, bool is_raw)
+{
+    if(!mem)
+    {
+        err_msg_ = "mem is nullptr";
+        return false;
+    }
+
+    if(mem_size < max_mem_size(max_sl_len))
+    {
+        err_msg_ = "mem_size not enough";
+        return false;
+    }
+
+    size_t header_size = mem_header_size();
+    size_t node_size = mem_node_size();
+    mem_header_ = reinterpret_cast<MemHeader*>(mem);
+    if(!is_raw)
+    {// 做一下简单的校验
+        if(mem_header_->magic_num != MAGIC_NUM || mem_header_->mem_size != mem_size
+            || mem_header_->header_size != header_size || mem_header_->node_size != node_size)
+        {
+            err_msg_ = "mem header check err";
+            return false;
+        }
+    }
+    else
+    {// 初始化内存头，头节点申请后就是全0，各排序的层都为空
+        memset(mem_header_, 0, header_size);
+
+        mem_header_->magic_num = MAGIC_NUM;
+        mem_header_->mem_size = mem_size;
+        mem_header_->alloc_size = header_size;
+        mem_header_->header_size = header_size;
+        mem_header_->node_size = node_size;
+        mem_header_->free_list = 0;
+        mem_header_->head = alloc_node();
+        mem_header_->length = 0;
+        for(int i = 0; i < INDEX_NUM; ++i)
+        {
+            mem_header_->sl_info[i].tail = 0;
+            mem_header_->sl_info[i].level_num = 1;
+        }
+    }
+
+    return true;
+}
+
+template<typename T, typename... Compares>
+template<int I>
+typename MultiIndexSkipList<T, Compares...>::MemNode*
+MultiIndexSkipList<T, Compares...>::find_update(const T& element, size_t* update, uint32_t* index, size_t node_ref) const
+{
+    MemNode* node = reinterpret_cast<MemNode*>(deref(mem_header_->head));
+    IndexCompare<I> cmp;
+    uint32_t total_span = 0;
+    for(int i = mem_header_->sl_info[I].level_num - 1; i >= 0; --i)
+    {
+        while(node->tower[I].level[i].forward)
+        {
+            size_t forward_ref = node->tower[I].level[i].forward;
+            MemNode* forward_node = reinterpret_cast<MemNode*>(deref(forward_ref));
+            if(cmp(forward_node->element, element) || (forward_ref < node_ref && !cmp(element, forward_node->element)))
+            {
+                total_span += node->tower[I].level[i].span;
+                node = forward_node;
+            }
+            else
+                break;
+        }
+
+        if(update) update[i] = ref(node);
+        if(index) index[i] = total_span;
+    }
+
+    return node;
+}
+
+template<typename T, typename... Compares>
+template<int I>
+uint32_t MultiIndexSkipList<T, Compares...>::get_index(const T& element) const
+{
+    uint32_t index[MAX_LEVEL_NUM] = {0};
+    MemNode* node = find_update<I>(element, nullptr, index);
+    if(node->tower[I].level[0].forward)
+    {
+        MemNode* forward_node = reinterpret_cast<MemNode*>(deref(node->tower[I].level[0].forward));
+        if(!IndexCompare<I>()(element, forward_node->element))
+            return index[0] + 1;
+    }
+
+    return 0;
+}
+
+template<typename T, typename... Compares>
+template<int I>
+typename MultiIndexSkipList<T, Compares...>::template Iterator<I>
+MultiIndexSkipList<T, Compares...>::find(const T& element) const
+{
+    MemNode* node = find_update<I>(element, nullptr, nullptr);
+    if(node->tower[I].level[0].forward)
+    {
+        MemNode* forward_node = reinterpret_cast<MemNode*>(deref(node->tower[I].level[0].forward));
+        if(!IndexCompare<I>()(element, forward_node->element))
+            return Iterator<I>(this, node->tower[I].level[0].forward);
+    }
+
+    return Iterator<I>(this, 0);
+}
+
+template<typename T, typename... Compares>
+template<int I>
+typename MultiIndexSkipList<T, Compares...>::template Iterator<I>
+MultiIndexSkipList<T, Compares...>::find(uint32_t index) const
+{
+    uint32_t total_span = 0;
+    MemNode* node = reinterpret_cast<MemNode*>(deref(mem_header_->head));
+    for(int i = mem_header_->sl_info[I].level_num - 1; i >= 0; --i)
+    {
+        while(node->tower[I].level[i].forward)
+        {
+            if(total_span + node->tower[I].level[i].span <= index)
+            {
+                total_span += node->tower[I].level[i].span;
+                node = reinterpret_cast<MemNode*>(deref(node->tower[I].level[i].forward));
+            }
+            else
+                break;
+        }
+
+        if(total_span == index && ref(node) != mem_header_->head)
+            return Iterator<I>(this, ref(node));
+    }
+
+    return Iterator<I>(this, 0);
+}
+
+template<typename T, typename... Compares>
+bool MultiIndexSkipList<T, Compares...>::insert(const T& element)
+{
+    size_t new_node_ref = alloc_node();
+    if(!new_node_ref) return false;
+
+    MemNode* new_node = reinterpret_cast<MemNode*>(deref(new_node_ref));
+    new_node->element = element;
+    link_from(new_node_ref, IndexTag<0>());
+    mem_header_->length += 1;
+
+    return true;
+}
+
+template<typename T, typename... Compares>
+template<int I>
+void MultiIndexSkipList<T, Compares...>::link_from(size_t new_node_ref, IndexTag<I>)
+{
+    MemNode* new_node = reinterpret_cast<MemNode*>(deref(new_node_ref));
+    SLInfo& sl_info = mem_header_->sl_info[I];
+
+    uint32_t index[MAX_LEVEL_NUM] = {0};
+    size_t update[MAX_LEVEL_NUM] = {0};
+    find_update<I>(new_node->element, update, index, new_node_ref);
+
+    int level = random_level();
+    if(level > sl_info.level_num)
+    {
+        for(int i = sl_info.level_num; i < level; ++i)
+        {
+            index[i] = 0;
+            update[i] = mem_header_->head;
+            MemNode* update_node = reinterpret_cast<MemNode*>(deref(update[i]));
+            update_node->tower[I].level[i].span = mem_header_->length;
+        }
+        sl_info.level_num = level;
+    }
+
+    SLTower& tower = new_node->tower[I];
+    tower.level_num = level;
+    for(int i = 0; i < level; ++i)
+    {
+        MemNode* update_node = reinterpret_cast<MemNode*>(deref(update[i]));
+        tower.level[i].forward = update_node->tower[I].level[i].forward;
+        update_node->tower[I].level[i].forward = new_node_ref;
+        tower.level[i].span = update_node->tower[I].level[i].span - (index[0] - index[i]);
+        update_node->tower[I].level[i].span = index[0] - index[i] + 1;
+    }
+
+    for(int i = level; i < sl_info.level_num; ++i)
+    {
+        MemNode* update_node = reinterpret_cast<MemNode*>(deref(update[i]));
+        update_node->tower[I].level[i].span += 1;
+    }
+
+    tower.backword = update[0] == mem_header_->head ? 0 : update[0];
+    if(tower.level[0].forward)
+    {
+        MemNode* forward_node = reinterpret_cast<MemNode*>(deref(tower.level[0].forward));
+        forward_node->tower[I].backword = new_node_ref;
+    }
+    else
+        sl_info.tail = new_node_ref;
+
+    link_from(new_node_ref, IndexTag<I + 1>());
+}
+
+template<typename T, typename... Compares>
+template<int I>
+uint32_t MultiIndexSkipList<T, Compares...>::erase(const T& element)
+{
+    uint32_t count = 0;
+    IndexCompare<I> cmp;
+    for(;;)
+    {
+        MemNode* node = find_update<I>(element, nullptr, nullptr);
+        size_t del_node_ref = node->tower[I].level[0].forward;
+        if(!del_node_ref) break;
+
+        MemNode* del_node = reinterpret_cast<MemNode*>(deref(del_node_ref));
+        if(cmp(element, del_node->element)) break;
+
+        unlink_from(del_node_ref, IndexTag<0>());
+        mem_header_->length -= 1;
+        free_node(del_node_ref);
+        ++count;
+    }
+
+    return count;
+}
+
+template<typename T, typename... Compares>
+template<int I>
+void MultiIndexSkipList<T, Compares...>::unlink_from(size_t del_node_ref, IndexTag<I>)
+{
+    MemNode* del_node = reinterpret_cast<MemNode*>(deref(del_node_ref));
+    SLInfo& sl_info = mem_header_->sl_info[I];
+
+    // 相同元素按节点偏移排序，按(元素, 偏移)查找直接得到要删除节点在各层的前驱，不用逐个越过相同元素
+    size_t update[MAX_LEVEL_NUM] = {0};
+    find_update<I>(del_node->element, update, nullptr, del_node_ref);
+
+    for(int i = 0; i < sl_info.level_num; ++i)
+    {
+        MemNode* update_node = reinterpret_cast<MemNode*>(deref(update[i]));
+        if(update_node->tower[I].level[i].forward == del_node_ref)
+        {
+            update_node->tower[I].level[i].span += del_node->tower[I].level[i].span;
+            update_node->tower[I].level[i].span -= 1;
+            update_node->tower[I].level[i].forward = del_node->tower[I].level[i].forward;
+        }
+        else
+        {
+            update_node->tower[I].level[i].span -= 1;
+        }
+    }
+
+    if(del_node->tower[I].level[0].forward)
+    {
+        MemNode* forward_node = reinterpret_cast<MemNode*>(deref(del_node->tower[I].level[0].forward));
+        forward_node->tower[I].backword = del_node->tower[I].backword;
+    }
+    else
+        sl_info.tail = del_node->tower[I].backword;
+
+    MemNode* head = reinterpret_cast<MemNode*>(deref(mem_header_->head));
+    while(sl_info.level_num > 1 && head->tower[I].level[sl_info.level_num - 1].forward == 0)
+        sl_info.level_num -= 1;
+
+    unlink_from(del_node_ref, IndexTag<I + 1>());
+}
+
+template<typename T, typename... Compares>
+size_t MultiIndexSkipList<T, Compares...>::alloc_node()
+{
+    size_t pos = 0;
+    MemNode* node = nullptr;
+    if(mem_header_->free_list)
+    {// 空闲链表非空，从空闲链表上申请节点
+        node = reinterpret_cast<MemNode*>(deref(mem_header_->free_list));
+        pos = mem_header_->free_list;
+        mem_header_->free_list = node->next;
+    }
+    else if(mem_header_->alloc_size + mem_header_->node_size <= mem_header_->mem_size)
+    {// 空闲链表为空且还有空间，从未使用的内存中申请节点
+        node = reinterpret_cast<MemNode*>(deref(mem_header_->alloc_size));
+        pos = mem_header_->alloc_size;
+        mem_header_->alloc_size += mem_header_->node_size;
+    }
+
+    if(node) memset(node, 0, mem_header_->node_size);
+
+    return pos;
+}
+
+template<typename T, typename... Compares>
+void MultiIndexSkipList<T, Compares...>::free_node(size_t node_ref)
+{
+    MemNode* node = reinterpret_cast<MemNode*>(deref(node_ref));
+    node->next = mem_header_->free_list;
+    mem_header_->free_list = node_ref;
+}
+
+#endif
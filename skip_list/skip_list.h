@@ -3,36 +3,306 @@
  * Created Date: 2018-04-20 20:13:43
  * Author      : philma
  * Desc        : 基于一段连续内存的跳跃表，支持重复元素，支持迭代器遍历，支持自定义排序
+ *               元素可以是SLString/SLVector这类外部数据放在区域内分配器上的类型，需要在init时指定分配区大小
  */
 
+#ifndef SKIP_LIST_H
+#define SKIP_LIST_H
+
 #include <string>
+#include <cstdio>
 #include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include "skip_list_alloc.h"
+#include "frozen_skip_list.h"
+#include "skip_list_probe.h"
+
+/*
+ * 跳跃表的节点布局策略，作为SkipList的第三个模板参数，需要时继承后覆盖其中的开关
+ */
+struct SLDefaultTraits
+{
+    // 每层除了后继节点的偏移，再保存一份后继节点元素的拷贝，下降时不前进的那一步不用访问后继节点
+    // 节点每层多一个元素的大小，只适用于可以按字节拷贝的元素
+    static const bool CACHE_FORWARD_KEY = false;
+
+    // 每个节点记录find/get_index命中的次数，rebalance_by_access()据此给热点元素分配更高的塔
+    static const bool TRACK_ACCESS = false;
+
+    // 每层记录跨度，关闭后节点变小，插入删除不再维护跨度，但不能使用按位置索引的操作
+    // （get_index、get_lower_index、get_upper_index、find(index)）
+    static const bool HAS_SPAN = true;
+
+    // 节点记录第0层的前一个节点，关闭后节点变小，迭代器不能往前走
+    static const bool HAS_BACKWORD = true;
+
+    // 内存头后面放一个脏页位图，插入删除时记下改动过的页，checkpoint()据此只写改动过的页
+    static const bool TRACK_DIRTY = false;
+
+    // 分段模式：init的内存用完后，通过set_segment_provider设置的回调申请新的段（不要求与原内存连续），
+    // 节点偏移的高位是段号、低位是段内偏移，节点多一个记录自身偏移的字段；不能与TRACK_DIRTY同时使用
+    static const bool SEGMENTED = false;
+};
+
+struct SLCacheKeyTraits : SLDefaultTraits
+{
+    static const bool CACHE_FORWARD_KEY = true;
+};
+
+// 按策略可有可无的层字段，不需要时是空基类，不占空间
+template<typename K, bool>
+struct SLForwardKeyField
+{
+    K forward_key;                      // 后继节点元素的拷贝
+};
+
+template<typename K>
+struct SLForwardKeyField<K, false>
+{};
+
+template<bool>
+struct SLSpanField
+{
+    uint32_t span;                      // 跳跃的跨度
+};
+
+template<>
+struct SLSpanField<false>
+{};
+
+template<bool>
+struct SLBackwordField
+{
+    size_t backword;                    // 指向前一个跳跃表节点，用于逆向遍历
+};
+
+template<>
+struct SLBackwordField<false>
+{};
+
+template<bool>
+struct SLAccessField
+{
+    uint32_t access_count;              // 查找命中的次数，近似值
+};
+
+template<>
+struct SLAccessField<false>
+{};
+
+static const int SL_MAX_SEGMENT_NUM = 256;  // 分段模式下最多的段数，包括第0段
+
+// 分段模式下段的信息
+struct SLSegmentInfo
+{
+    size_t size;                        // 段大小
+    size_t alloc_size;                  // 段内已申请的大小
+};
+
+// 放在内存头中的段表
+template<bool>
+struct SLSegmentField
+{
+    uint32_t segment_num;               // 段数，第0段是init时的内存，不在段表中
+    size_t segment_size;                // 新段的大小
+    SLSegmentInfo segments[SL_MAX_SEGMENT_NUM];
+};
+
+template<>
+struct SLSegmentField<false>
+{};
+
+// 分段模式下节点记录自身的偏移，由节点地址求偏移时不用查段表
+template<bool>
+struct SLSelfRefField
+{
+    size_t self_ref;
+};
+
+template<>
+struct SLSelfRefField<false>
+{};
+
+/*
+ * 段的提供者，segment_id从1开始
+ * create为true时新建一个segment_size大小的段（如新的共享内存对象或文件）并映射，为false时映射已经存在的段
+ * 返回段在本进程中的地址，失败时返回nullptr
+ */
+typedef std::function<void*(uint32_t segment_id, size_t segment_size, bool create)> SLSegmentProvider;
+
+// 预热方式，见SkipList::warm
+enum SLWarmMode
+{
+    SL_WARM_TOUCH = 1,                  // 多个线程逐页读一个字节，同步触发缺页
+    SL_WARM_POPULATE = 2,               // madvise(MADV_POPULATE_READ)由内核同步填充页表，内核不支持时退回SL_WARM_TOUCH
+    SL_WARM_WILLNEED = 3,               // madvise(MADV_WILLNEED)只发起预读，立即返回
+};
+
+// 批量插入实际走的路径，见SkipList::insert_bulk
+enum SLBulkPath
+{
+    SL_BULK_NONE = 0,                   // 批次为空或插入失败，表没有改动
+    SL_BULK_FINGER = 1,                 // 按序逐个插入，每次从上一次的插入路径继续下降
+    SL_BULK_MERGE = 2,                  // 沿第0层顺序归并，同时把新节点接进各层
+};
+
+// 检查点文件头，之后是range_num段数据，每段为8字节偏移、8字节长度加上数据
+struct SLCheckpointHeader
+{
+    uint32_t magic_num;
+    uint32_t full;                      // 是否是基准检查点（包含全部已使用的内存）
+    uint64_t seq;                       // 检查点序号，增量检查点的序号须紧接上一个检查点
+    uint64_t base_id;                   // 所属基准检查点的标识，增量检查点须和基准检查点相同
+    size_t mem_size;                    // 区域总大小，恢复时的内存大小必须相同
+    size_t node_size;                   // 节点大小，恢复时校验元素类型
+    uint64_t range_num;                 // 数据段数
+};
+
+static const uint32_t SL_CHECKPOINT_MAGIC_NUM = 0x534c4350;
+
+/*
+ * 生成一个跨进程、跨重启基本不会重复的64位标识：时钟、进程号和进程内计数混合后再散列
+ */
+inline uint64_t sl_unique_id()
+{
+    static std::atomic<uint64_t> counter(0);
+    uint64_t x = static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+    x ^= static_cast<uint64_t>(getpid()) << 32;
+    x += (counter.fetch_add(1) + 1) * 0x9e3779b97f4a7c15ULL;
+
+    // splitmix64的末尾混合
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+
+    return x ? x : 1;
+}
+
+/*
+ * 把path所在目录落盘，rename之后调用，保证崩溃后目录项指向新文件
+ */
+inline bool sl_sync_dir(const char* path)
+{
+    std::string dir_path(path);
+    size_t slash = dir_path.rfind('/');
+    dir_path = slash == std::string::npos ? "." : (slash ? dir_path.substr(0, slash) : "/");
+    int fd = ::open(dir_path.c_str(), O_RDONLY);
+    bool ok = fd >= 0 && fsync(fd) == 0;
+    if(fd >= 0) ::close(fd);
+
+    return ok;
+}
 
-template<typename T, typename Compare = std::less<T>>
+template<typename T, typename Compare = std::less<T>, typename Traits = SLDefaultTraits>
 class SkipList
 {
     static const int MAX_LEVEL_NUM = 32;        // 跳跃表的最大层数
     static const int SKIPLIST_P = 4;            // 跳跃表随机层数，每增加一层的概率，多少分之一
 
+    static_assert(!Traits::CACHE_FORWARD_KEY || std::is_trivially_copyable<T>::value,
+        "CACHE_FORWARD_KEY requires trivially copyable element");
+    static_assert(!(Traits::SEGMENTED && Traits::TRACK_DIRTY), "SEGMENTED can not be used with TRACK_DIRTY");
+
 public:
     class Iterator;
+
+    // 内存使用和结构统计，见stats()
+    struct Stats
+    {
+        size_t mem_size;                // 总内存大小
+        size_t header_size;             // 内存头部大小
+        size_t node_size;               // 节点大小
+        size_t alloc_size;              // 已申请大小，包括空闲节点
+        uint64_t version;               // 修改版本号
+        uint32_t length;                // 元素个数
+        int level_num;                  // 当前层数
+        uint32_t free_num;              // 空闲链表上的节点数
+        double fragmentation;           // 空闲节点占已申请节点空间的比例
+        uint32_t level_count[MAX_LEVEL_NUM];    // 第i层上链接的节点数，level_count[i] - level_count[i + 1]为恰好i + 1层的节点数
+        size_t arena_size;              // 分配区大小，没有分配区时为0
+        size_t arena_alloc_size;        // 分配区已切分的大小
+        size_t arena_used_size;         // 分配区中正在使用的大小
+    };
     
     /*
      * 初始化跳跃表
+     * arena_size非0时在内存尾部划出这么大的分配区，存放元素的外部数据（见skip_list_alloc.h），is_raw为false时忽略
+     * 元素不能按字节拷贝（如SLString）时必须有分配区，否则外部数据会落在本进程的堆上，其他进程挂接后指针无效，init返回false
+     */
+    bool init(void* mem, size_t mem_size, uint32_t max_sl_len, bool is_raw = true, size_t arena_size = 0);
+
+    /*
+     * 分段模式（Traits::SEGMENTED）下设置段的提供者，须在init之前调用
+     * 以is_raw=true初始化时，segment_size为之后每个新段的大小（记录在内存头中），init的内存用完后由provider新建段；
+     * 挂接时忽略segment_size，init时由provider映射所有已经存在的段，映射失败时init返回false
+     * 不设置时表不会增长，行为同非分段模式；段只增不减
+     */
+    void set_segment_provider(const SLSegmentProvider& provider, size_t segment_size = 0)
+    {
+        segment_provider_ = provider;
+        segment_size_ = segment_size;
+    }
+
+    /*
+     * 分段模式下映射其他进程在init之后新增的段，失败时返回false，原因见err_msg；不是分段模式时直接返回true
+     * 挂接方在属主增长表之后（内存头中的段数变大）调用；查询中途遇到还没映射的段时也会就地映射，
+     * 但那时无法报告错误，映射失败的段上的节点被当作表尾，查询结果不完整，之后调用本函数可以得到原因
+     * 可以与本对象上的并发查询同时调用
      */
-    bool init(void* mem, size_t mem_size, uint32_t max_sl_len, bool is_raw = true);
+    bool map_segments() { return map_segments(Segmented()); }
 
     /*
      * 查找元素在跳跃表中的位置索引（如果有多个相同元素，取排在最前面元素的位置），索引值从1开始
      * 返回0表示没找到
      */
-    uint32_t get_index(const T& element) const;
+    uint32_t get_index(const T& element) const { return get_index_of(element); }
+
+    /*
+     * 异构查找：Compare定义了is_transparent时，可以直接用能与T比较的键查找（如用SLStrView查SLString），
+     * 下降过程中直接拿键和节点元素比较，不用先构造一个T
+     */
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    uint32_t get_index(const K& key) const { return get_index_of(key); }
+
+    /*
+     * 查找第一个不小于element的元素的位置索引，索引值从1开始，所有元素都小于element时返回length + 1
+     * 即表中小于element的元素个数加1
+     */
+    uint32_t get_lower_index(const T& element) const { return count_before(element, false) + 1; }
+
+    /*
+     * 查找第一个大于element的元素的位置索引，索引值从1开始，所有元素都不大于element时返回length + 1
+     * 即表中不大于element的元素个数加1
+     */
+    uint32_t get_upper_index(const T& element) const { return count_before(element, true) + 1; }
 
     /*
      * 根据元素查找跳跃表，返回元素所在位置的迭代器（如果有多个相同元素，取排在最前面元素的位置）
      * 找不到则返回迭代器同end函数
      */
-    Iterator find(const T& element) const;
+    Iterator find(const T& element) const { return find_of(element); }
+
+    /*
+     * 异构查找，同get_index；整数参数仍然表示按位置索引查找
+     */
+    template<typename K, typename C = Compare,
+        typename = typename std::enable_if<!std::is_integral<K>::value, typename C::is_transparent>::type>
+    Iterator find(const K& key) const { return find_of(key); }
 
     /*
      * 根据位置索引查找跳跃表，返回对应位置的迭代器，位置索引从1开始
@@ -40,9 +310,21 @@ public:
      */
     Iterator find(uint32_t index) const;
 
+    /*
+     * 查找第一个不小于element的元素，返回其迭代器，没有则返回迭代器同end函数
+     */
+    Iterator lower_bound(const T& element) const { return lower_bound_of(element); }
+
+    /*
+     * 异构查找，同get_index
+     */
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    Iterator lower_bound(const K& key) const { return lower_bound_of(key); }
+
     /*
      * 插入一个元素，支持相同的元素插入，后插入的相同元素排在先插入的前面
-     * 返回false表示插入失败，仅在空间不足的情况下发生
+     * 元素在节点中拷贝构造，构造期间当前线程的分配区指向本表的分配区
+     * 返回false表示插入失败，仅在空间不足（节点或分配区）的情况下发生
      */
     bool insert(const T& element);
 
@@ -53,21 +335,150 @@ public:
     uint32_t erase(const T& element);
 
     /*
-     * 根据跳跃表的最大长度，获取需要的最大内存大小
+     * 批量插入[first, last)中的元素，批次不要求有序，与表中相同的元素排在表中元素前面，批次内相同元素的先后不确定
+     * 先为所有元素申请节点并拷贝构造，由thread_num个线程并行排序，再按代价模型（批次大小m、表长n）选择：
+     *   SL_BULK_FINGER 逐个插入，约m * log_P(n / m)步，适合批次相对表很小的情况
+     *   SL_BULK_MERGE  沿第0层顺序归并，同时把新节点按随机塔高接进各层，原有节点塔高不变，约n + m步，
+     *                  适合批次占表长比例较大的情况（n = 100万的随机整数表上，分界点在m约为n的20%）
+     * path非空时返回实际走的路径；空间不足（节点或分配区）时一个元素也不插入，返回false
+     */
+    template<typename InputIt>
+    bool insert_bulk(InputIt first, InputIt last, int thread_num = 1, SLBulkPath* path = nullptr);
+
+    /*
+     * 删除所有满足pred(element)的元素，返回删除的元素个数
+     * 沿第0层走一遍，记下每层最后一个保留的节点，边走边把各层接到下一个保留的节点上并重算跨度，O(n)，不做重复的下降
+     * pred中不能修改跳跃表；pred或Compare抛出异常时，之前已判定删除的元素照样删除，表保持完整，异常继续抛出
+     */
+    template<typename Pred>
+    uint32_t erase_if(Pred pred);
+
+    /*
+     * 只删除[lo, hi]范围内满足pred(element)的元素，先下降到lo，再沿第0层走到hi之后，O(log n + 范围内的元素个数)
+     */
+    template<typename Pred>
+    uint32_t erase_if(const T& lo, const T& hi, Pred pred);
+
+    /*
+     * 删除所有元素，节点回到空闲链表，O(n)
+     */
+    void clear();
+
+    /*
+     * 按位置索引重新分配确定的塔高：位置索引能被P^k整除的节点有k+1层（每4个节点有一个2层，每16个有一个3层……）
+     * 用于长期插入删除（尤其是大量删除）之后，塔高分布偏离理想分布、层数虚高的情况，重新保证最坏查找深度
+     * 沿第0层顺序走一遍完成所有层的重新链接，O(n)，不移动节点，不申请内存
+     */
+    void rebalance();
+
+    /*
+     * 当前层数比按长度计算的理想层数多2层以上时返回true，可以作为调用rebalance的参考
+     */
+    bool need_rebalance() const
+    {
+        int ideal = 1;
+        for(uint32_t len = mem_header_->sl_info.length; len >= static_cast<uint32_t>(SKIPLIST_P); len /= SKIPLIST_P)
+            ++ideal;
+
+        return mem_header_->sl_info.level_num > ideal + 2;
+    }
+
+    /*
+     * 按访问次数重新分配塔高，需要Traits::TRACK_ACCESS
+     * 命中次数达到平均值P^k倍的节点至少有k+1层，查找它经过的层数接近按访问概率的熵下界；其余节点重新随机层数
+     * 沿第0层顺序走一遍完成所有层的重新链接，O(n)；完成后所有节点的命中次数减半，使统计偏向近期的访问
+     */
+    void rebalance_by_access();
+
+    /*
+     * 根据跳跃表的最大长度，获取需要的最大内存大小，arena_size为元素外部数据分配区的大小
      */
-    size_t max_mem_size(uint32_t max_sl_len) const
+    size_t max_mem_size(uint32_t max_sl_len, size_t arena_size = 0) const
     {
-        size_t size = mem_header_size();
+        size_t size = mem_header_size(0);
         size += (max_sl_len + 1) * mem_node_size();
+        size += (arena_size + 7) & (~7);
+
+        // 位图覆盖整个区域，区域又包括位图，迭代到够用为止
+        size_t base = size;
+        while(base + dirty_map_size(size) > size)
+            size = base + dirty_map_size(size);
 
         return size;
     }
 
+    /*
+     * 按当前长度冻结需要的内存大小
+     */
+    size_t frozen_mem_size() const { return FrozenSkipList<T, Compare>::mem_size_of(length()); }
+
+    /*
+     * 把当前内容导出成只读、没有指针的冻结布局（有序数组加采样索引，见frozen_skip_list.h），
+     * 读者用FrozenSkipList挂接后查询；元素须能按字节拷贝，空间不足时返回false
+     */
+    bool freeze_to(void* mem, size_t mem_size) const
+    {
+        return FrozenSkipList<T, Compare>::build(begin(), length(), mem, mem_size);
+    }
+
     /*
      * 获取跳跃表内部的错误信息
      */
     const std::string& err_msg() const { return err_msg_; }
 
+    /*
+     * 开启或关闭查找路径缓存（默认关闭）
+     * 开启后每个线程记住上一次下降时各层停下的节点，下一次find/get_index/lower_bound/insert/erase
+     * 从缓存中仍然夹住新元素的最低层继续往下，适合同一线程连续查找相近元素的场景
+     * 缓存带有表的初始化标识和修改版本号，其他线程或进程修改过表、或者同一块内存重新初始化之后缓存自动失效
+     */
+    void set_finger_cache(bool enable) { finger_cache_ = enable; }
+
+    /*
+     * 预热已使用的内存（头部到alloc_size的节点区，以及分配区已切分的部分），用于挂接刚映射的大块内存后，
+     * 避免第一批查询卡在缺页上；只读不写，不会弄脏页面
+     * thread_num为SL_WARM_TOUCH使用的线程数，lock为true时再用mlock把这部分内存锁在物理内存中
+     * cost_us非空时返回预热耗时（微秒）；返回false表示madvise或mlock失败，原因见err_msg
+     * 分段模式下只预热init的那块内存
+     */
+    bool warm(SLWarmMode mode, int thread_num = 1, bool lock = false, uint64_t* cost_us = nullptr);
+
+    /*
+     * 统计内存使用和各层节点数，沿空闲链表和各层链表走一遍，O(n)，只读
+     * 可以在其他进程修改表的同时调用（如运维工具只读挂接后查看），此时结果只是近似值，遍历步数以已申请的节点数为上限
+     */
+    void stats(Stats& stats) const;
+
+    /*
+     * 把区域写成检查点文件，需要Traits::TRACK_DIRTY
+     * full为true时写入全部已使用的内存，作为基准；否则只写入上一次检查点之后插入删除改动过的页（DIRTY_PAGE_SIZE为单位）
+     * 分配区不记录脏页，有分配区时每次都整体写入已切分的部分；通过迭代器在表外修改元素、查找时累加的命中次数不会被记录
+     * 先写到path.tmp，落盘后rename到path再同步目录，崩溃时path上只会是完整的旧文件或新文件
+     * 每个基准检查点生成新的标识，之后的增量检查点都带上它；还没有写过基准检查点时不能写增量检查点
+     * 成功后清空脏页位图，返回false表示写文件失败，位图保持不变
+     */
+    bool checkpoint(const char* path, bool full = false);
+
+    /*
+     * 把基准检查点和之后的增量检查点依次写回mem，然后挂接（同init的is_raw=false）
+     * paths中第一个须是基准检查点，之后的增量检查点须属于同一个基准检查点并按序号连续
+     */
+    bool restore(void* mem, size_t mem_size, uint32_t max_sl_len, const std::vector<std::string>& paths);
+
+    /*
+     * 元素外部数据的分配区，没有时返回nullptr
+     * 在表外修改元素时（如通过迭代器给SLString赋值），元素仍使用构造时绑定的分配区
+     */
+    SLArena* arena() const
+    {
+        return mem_header_->arena ? reinterpret_cast<SLArena*>(deref(mem_header_->arena)) : nullptr;
+    }
+
+    /*
+     * 跳跃表当前的长度，即表中元素个数
+     */
+    uint32_t length() const { return mem_header_->sl_info.length; }
+
     Iterator begin() const
     {
         MemNode* node = reinterpret_cast<MemNode*>(deref(mem_header_->sl_info.head));
@@ -135,6 +546,7 @@ public:
 
         Iterator& operator--()
         {
+            static_assert(Traits::HAS_BACKWORD, "reverse iteration requires Traits::HAS_BACKWORD");
             MemNode* node = reinterpret_cast<MemNode*>(skip_list->deref(node_ref));
             node_ref = node->sl_node_info.backword;
             return *this;             
@@ -142,6 +554,7 @@ public:
 
         Iterator operator--(int)
         {
+            static_assert(Traits::HAS_BACKWORD, "reverse iteration requires Traits::HAS_BACKWORD");
             Iterator tmp = *this;
             MemNode* node = reinterpret_cast<MemNode*>(skip_list->deref(node_ref));
             node_ref = node->sl_node_info.backword;
@@ -155,8 +568,71 @@ public:
 
 private:
 
+    template<typename, typename, typename, typename> friend class SkipList2D;
+    template<typename, typename, typename> friend class ElidedSkipList;
+    template<typename, typename, typename> friend class SkipListWAL;
+    template<typename, typename, typename> friend class HeapSkipList;
+
+    static const size_t DIRTY_PAGE_SIZE = 4096; // 脏页位图中每一位对应的字节数
+    static const int SEGMENT_SHIFT = 40;        // 分段模式下偏移中段号的位置，段大小不超过1T
+    static const size_t SEGMENT_MASK = (static_cast<size_t>(1) << SEGMENT_SHIFT) - 1;
+    static const size_t BULK_SORT_GRAIN = 16384;    // 批量插入时每个排序线程至少分到的元素个数
+    static const uint64_t BULK_MERGE_COST_MUL = 3;  // 批量插入的代价模型中，归并时走过一个节点折合逐个插入时前进一步的MUL / DIV倍
+    static const uint64_t BULK_MERGE_COST_DIV = 5;
+
+    struct MemNode;
+
     // 删除一个元素，如果有多个，删除排在最前的那个；返回false表示没找到要删除的元素
-    bool del_first_of(const T& element);
+    // unlinked不为空时只从各层摘下节点，不改长度和版本号，也不释放节点，节点偏移通过unlinked交给调用者
+    bool del_first_of(const T& element, size_t* unlinked = nullptr);
+
+    // 从各层的update节点（位置索引为index）开始沿第0层往后走，删除满足pred的元素，遇到满足stop的元素时停下
+    template<typename Stop, typename Pred>
+    uint32_t erase_walk(const size_t* update, const uint32_t* index, Stop stop, Pred pred);
+
+    // 把已构造好元素的节点按随机层数链接进表中，返回层数
+    // count为false时不改长度和版本号，由调用者在表外计数，新增层的跨度改为从最高层的跨度累加出长度
+    // level不为0时用调用者事先取好的层数，不在这里调用random()
+    int link_node(size_t new_node_ref, bool count = true, int level = 0);
+
+    // 沿最高层累加各节点的跨度得到表长，不依赖表头的长度字段，最高层节点很少，代价接近O(1)
+    uint32_t span_length() const;
+
+    // thread_num个线程各排一段，再两两归并
+    static void sort_nodes(std::vector<MemNode*>& nodes, int thread_num);
+
+    // 把有序的nodes沿第0层归并进表中，一遍完成各层的链接，原有节点塔高不变
+    void merge_nodes(const std::vector<MemNode*>& nodes);
+
+    // 按元素查找的实现，K为T或者能与T比较的键类型
+    template<typename K>
+    uint32_t get_index_of(const K& key) const;
+
+    template<typename K>
+    Iterator find_of(const K& key) const;
+
+    template<typename K>
+    Iterator lower_bound_of(const K& key) const;
+
+    // 查找第一个等于key的节点，返回节点偏移，找不到时返回0；rank为其位置索引
+    template<typename K>
+    size_t find_first(const K& key, uint32_t& rank) const;
+
+    // 统计表中小于element（inclusive为true时是不大于element）的元素个数
+    uint32_t count_before(const T& element, bool inclusive) const;
+
+    // 从头节点（或查找路径缓存）下降到第0层最后一个小于key的节点
+    // update、index非空时填入每层停下的节点偏移和该节点的位置索引
+    template<typename K>
+    MemNode* descend(const K& key, size_t* update, uint32_t* index) const;
+
+    // 把一次下降的路径记入当前线程的查找路径缓存
+    void save_finger(const size_t* update, const uint32_t* index) const;
+
+    // 按新的塔高重新链接第0层以上的所有层，只沿第0层顺序走一遍
+    // height(rank, node)返回位置索引为rank的节点的新层数
+    template<typename HeightFn>
+    void relink(HeightFn height);
 
 private:
 
@@ -170,20 +646,20 @@ private:
         uint32_t length;                // 跳跃表当前的长度，即表中元素个数
     };
 
-    struct SLLevel
+    // 跨度按Traits::HAS_SPAN可有可无，通过span_of/set_span访问
+    struct SLLevel : SLForwardKeyField<T, Traits::CACHE_FORWARD_KEY>, SLSpanField<Traits::HAS_SPAN>
     {
         size_t forward;                 // 指向跳到的下一个跳跃表节点
-        uint32_t span;                  // 跳跃的跨度
     };
 
-    struct SLNodeInfo
+    // 前一个节点按Traits::HAS_BACKWORD可有可无，通过backword_of/set_backword访问
+    struct SLNodeInfo : SLBackwordField<Traits::HAS_BACKWORD>
     {
         T element;                      // 跳跃表中存放的元素
-        size_t backword;                // 指向前一个跳跃表节点，用于逆向遍历
         SLLevel level[MAX_LEVEL_NUM];   // 跳跃表节点中的层
     };
 
-    struct MemHeader
+    struct MemHeader : SLSegmentField<Traits::SEGMENTED>
     {
         uint32_t magic_num;
         size_t mem_size;                // 总内存大小
@@ -191,18 +667,56 @@ private:
         size_t header_size;             // 内存头部大小
         size_t node_size;               // 节点大小
         size_t free_list;               // 空闲节点列表，为0表示列表为空
+        uint64_t version;               // 修改版本号，每次插入删除加1，用于判断查找路径缓存是否失效
+        uint64_t init_id;               // 每次初始化（is_raw=true）生成的随机标识，同一块内存重新初始化后版本号从0开始，靠它区分新旧表
+        size_t arena;                   // 元素外部数据分配区的偏移，在内存尾部，为0表示没有分配区
+        size_t dirty;                   // 脏页位图的偏移，紧跟在内存头后面，为0表示不记录脏页
+        uint64_t checkpoint_seq;        // 上一个检查点的序号
+        uint64_t checkpoint_base;       // 上一个基准检查点的标识，为0表示还没有写过基准检查点
         SLInfo sl_info;                 // 跳跃表的信息
     };
 
-    struct MemNode
+    struct MemNode : SLAccessField<Traits::TRACK_ACCESS>, SLSelfRefField<Traits::SEGMENTED>
     {
         SLNodeInfo sl_node_info;        // 跳跃表节点信息
         size_t next;                    // 空闲列表中，下一节点的偏移
     };
 
-    size_t mem_header_size() const
+    // 分段模式下各段在本进程中的地址，查询中途就地映射时在锁内映射，再原子地发布地址
+    struct SegmentMap
+    {
+        std::atomic<void*> base[SL_MAX_SEGMENT_NUM];
+        std::mutex mutex;
+    };
+
+    // 查找路径缓存，每个线程一份
+    struct SLFinger
     {
-        return (sizeof(MemHeader) + 7) & (~7);
+        const MemHeader* owner;         // 缓存所属的表，同一线程交替访问多个表时互相覆盖
+        uint64_t init_id;               // 记录缓存时表的初始化标识
+        uint64_t version;               // 记录缓存时表的修改版本号
+        int level_num;                  // 记录缓存时表的层数
+        size_t update[MAX_LEVEL_NUM];   // 每层最后一个小于查找元素的节点
+        uint32_t index[MAX_LEVEL_NUM];  // 上述节点的位置索引
+    };
+
+    static SLFinger& finger()
+    {
+        static thread_local SLFinger finger_;
+        return finger_;
+    }
+
+    // 内存头的大小，记录脏页时包括覆盖整个区域的脏页位图
+    size_t mem_header_size(size_t mem_size) const
+    {
+        return ((sizeof(MemHeader) + 7) & (~7)) + dirty_map_size(mem_size);
+    }
+
+    static size_t dirty_map_size(size_t mem_size)
+    {
+        if(!Traits::TRACK_DIRTY) return 0;
+
+        return ((mem_size + DIRTY_PAGE_SIZE - 1) / DIRTY_PAGE_SIZE + 63) / 64 * 8;
     }
 
     size_t mem_node_size() const
@@ -210,16 +724,172 @@ private:
         return (sizeof(MemNode) + 7) & (~7);
     }
 
-    size_t ref(void* p) const
+    typedef std::integral_constant<bool, Traits::CACHE_FORWARD_KEY> CacheForwardKey;
+    typedef std::integral_constant<bool, Traits::TRACK_ACCESS> TrackAccess;
+    typedef std::integral_constant<bool, Traits::HAS_SPAN> HasSpan;
+    typedef std::integral_constant<bool, Traits::HAS_BACKWORD> HasBackword;
+    typedef std::integral_constant<bool, Traits::TRACK_DIRTY> TrackDirty;
+    typedef std::integral_constant<bool, Traits::SEGMENTED> Segmented;
+
+    // 把[pos, pos + size)所在的页记为脏页，不记录脏页时什么都不做
+    void mark_dirty(size_t pos, size_t size) { mark_dirty(pos, size, TrackDirty()); }
+
+    void mark_dirty(size_t pos, size_t size, std::true_type)
+    {
+        uint64_t* map = reinterpret_cast<uint64_t*>(deref(mem_header_->dirty));
+        for(size_t page = pos / DIRTY_PAGE_SIZE; page <= (pos + size - 1) / DIRTY_PAGE_SIZE; ++page)
+            map[page / 64] |= static_cast<uint64_t>(1) << (page % 64);
+    }
+
+    void mark_dirty(size_t, size_t, std::false_type) {}
+
+    // 节点和内存头（不含位图）所在的页记为脏页
+    void mark_node_dirty(size_t node_ref) { mark_dirty(node_ref, mem_header_->node_size); }
+
+    void mark_header_dirty() { mark_dirty(0, sizeof(MemHeader)); }
+
+    // 没有跨度时读出0，写入忽略，插入删除中维护跨度的代码被编译器去掉
+    static uint32_t span_of(const SLLevel& level) { return span_of(level, HasSpan()); }
+    static uint32_t span_of(const SLLevel& level, std::true_type) { return level.span; }
+    static uint32_t span_of(const SLLevel&, std::false_type) { return 0; }
+
+    static void set_span(SLLevel& level, uint32_t span) { set_span(level, span, HasSpan()); }
+    static void set_span(SLLevel& level, uint32_t span, std::true_type) { level.span = span; }
+    static void set_span(SLLevel&, uint32_t, std::false_type) {}
+
+    static size_t backword_of(const MemNode* node) { return backword_of(node, HasBackword()); }
+    static size_t backword_of(const MemNode* node, std::true_type) { return node->sl_node_info.backword; }
+    static size_t backword_of(const MemNode*, std::false_type) { return 0; }
+
+    static void set_backword(MemNode* node, size_t backword) { set_backword(node, backword, HasBackword()); }
+    static void set_backword(MemNode* node, size_t backword, std::true_type) { node->sl_node_info.backword = backword; }
+    static void set_backword(MemNode*, size_t, std::false_type) {}
+
+    // forward是node在第i层的后继且等于key，判断它是不是第一个等于key的元素，没有backword时无法判断，返回false
+    template<typename K>
+    bool is_first_equal(const MemNode* node, size_t forward, const K& key, std::true_type) const
+    {
+        size_t backword = backword_of(reinterpret_cast<MemNode*>(deref(forward)));
+        return !backword || backword == ref(const_cast<MemNode*>(node))
+            || Compare()(reinterpret_cast<MemNode*>(deref(backword))->sl_node_info.element, key);
+    }
+
+    template<typename K>
+    bool is_first_equal(const MemNode*, size_t, const K&, std::false_type) const { return false; }
+
+    // 查找命中时累加节点的命中次数，多个读者同时查找时用原子加
+    void touch(size_t node_ref) const { touch(node_ref, TrackAccess()); }
+
+    void touch(size_t node_ref, std::true_type) const
+    {
+        MemNode* node = reinterpret_cast<MemNode*>(deref(node_ref));
+        __atomic_fetch_add(&node->access_count, 1, __ATOMIC_RELAXED);
+    }
+
+    void touch(size_t, std::false_type) const {}
+
+    // 第i层后继节点的元素，开启CACHE_FORWARD_KEY时直接取本层保存的拷贝，不访问后继节点
+    const T& forward_key(const MemNode* node, int i) const { return forward_key(node, i, CacheForwardKey()); }
+
+    const T& forward_key(const MemNode* node, int i, std::true_type) const
+    {
+        return node->sl_node_info.level[i].forward_key;
+    }
+
+    const T& forward_key(const MemNode* node, int i, std::false_type) const
+    {
+        return reinterpret_cast<MemNode*>(deref(node->sl_node_info.level[i].forward))->sl_node_info.element;
+    }
+
+    // 设置第i层的后继节点，开启CACHE_FORWARD_KEY时同时更新保存的后继元素
+    void set_forward(MemNode* node, int i, size_t forward) { set_forward(node, i, forward, CacheForwardKey()); }
+
+    void set_forward(MemNode* node, int i, size_t forward, std::true_type)
+    {
+        node->sl_node_info.level[i].forward = forward;
+        if(forward)
+            node->sl_node_info.level[i].forward_key = reinterpret_cast<MemNode*>(deref(forward))->sl_node_info.element;
+    }
+
+    void set_forward(MemNode* node, int i, size_t forward, std::false_type)
+    {
+        node->sl_node_info.level[i].forward = forward;
+    }
+
+    // 节点的偏移，分段模式下取节点记录的自身偏移
+    size_t ref(const MemNode* node) const { return ref(node, Segmented()); }
+
+    size_t ref(const MemNode* node, std::true_type) const { return node->self_ref; }
+
+    size_t ref(const MemNode* node, std::false_type) const
     {
-        return reinterpret_cast<char*>(p) - reinterpret_cast<char*>(mem_header_);
+        return reinterpret_cast<const char*>(node) - reinterpret_cast<char*>(mem_header_);
     }
 
-    void* deref(size_t ref) const
+    void set_self_ref(MemNode* node, size_t ref) { set_self_ref(node, ref, Segmented()); }
+    void set_self_ref(MemNode* node, size_t ref, std::true_type) { node->self_ref = ref; }
+    void set_self_ref(MemNode*, size_t, std::false_type) {}
+
+    void* deref(size_t ref) const { return deref(ref, Segmented()); }
+
+    void* deref(size_t ref, std::false_type) const
     {
         return reinterpret_cast<char*>(mem_header_) + ref;
     }
 
+    // 段号为0时在init的内存中；其他段在init或申请新段时已经映射，只有其他进程在init之后新增的段才在这里就地映射
+    void* deref(size_t ref, std::true_type) const
+    {
+        size_t segment_id = ref >> SEGMENT_SHIFT;
+        if(!segment_id) return reinterpret_cast<char*>(mem_header_) + ref;
+
+        char* base = reinterpret_cast<char*>(segment_map_->base[segment_id].load(std::memory_order_acquire));
+        if(__builtin_expect(!base, 0))
+        {
+            base = reinterpret_cast<char*>(map_segment(segment_id));
+            if(!base) return segment_sentinel();
+        }
+
+        return base + (ref & SEGMENT_MASK);
+    }
+
+    // 映射一个已经存在的段并发布地址，持有segment_map_的锁，多个线程同时映射同一段时只映射一次；失败时返回nullptr
+    void* map_segment(size_t segment_id) const;
+
+    bool map_segments(std::true_type);
+    bool map_segments(std::false_type) { return true; }
+
+    // 映射失败的段上的节点用这个全0的节点代替：没有后继，查询走到这里就停下
+    static MemNode* segment_sentinel()
+    {
+        alignas(MemNode) static char sentinel[sizeof(MemNode)] = {0};
+        return reinterpret_cast<MemNode*>(sentinel);
+    }
+
+    // 当前段都用完时，在最后一段或新段上申请节点，返回节点的偏移；不是分段模式或者申请新段失败时返回0
+    size_t alloc_segment_node() { return alloc_segment_node(Segmented()); }
+    size_t alloc_segment_node(std::true_type);
+    size_t alloc_segment_node(std::false_type) { return 0; }
+
+    // 已申请的节点数（包括空闲节点和头节点），用于限制遍历步数
+    size_t alloc_node_num() const;
+
+    void init_segments(std::true_type)
+    {
+        mem_header_->segment_num = 1;
+        mem_header_->segment_size = segment_provider_ ? segment_size_ : 0;
+    }
+
+    void init_segments(std::false_type) {}
+
+    void alloc_segment_node_num(size_t& node_num, std::true_type) const
+    {
+        for(uint32_t i = 1; i < mem_header_->segment_num; ++i)
+            node_num += mem_header_->segments[i].alloc_size / mem_header_->node_size;
+    }
+
+    void alloc_segment_node_num(size_t&, std::false_type) const {}
+
     int random_level() const
     {
         int level = 1;
@@ -229,19 +899,33 @@ private:
         return (level < MAX_LEVEL_NUM ? level : MAX_LEVEL_NUM);
     }
 
+    // 预热[begin, end)，按页对齐后处理
+    bool warm_range(char* begin, char* end, SLWarmMode mode, int thread_num, bool lock);
+
     // 申请一个内存节点，返回节点的偏移；返回0表示内存不够了，申请失败
     size_t alloc_node();
 
-    // 释放一个内存节点到空闲链表
+    // 清空pos处的节点以便重新使用，alloc_node申请到的节点已经清空过
+    void reset_node(size_t pos);
+
+    // 析构节点中的元素，并释放节点到空闲链表
     void free_node(size_t node_ref);
 
+    // 释放一个内存节点到空闲链表，不析构元素
+    void release_node(size_t node_ref);
+
 private:
     MemHeader* mem_header_ = nullptr;
+    bool finger_cache_ = false;
+    bool heap_elements_ = false;                // 没有分配区时允许元素的外部数据放在本进程的堆上，只给HeapSkipList这类不跨进程的表用
+    SLSegmentProvider segment_provider_;
+    size_t segment_size_ = 0;
+    std::shared_ptr<SegmentMap> segment_map_;   // 各段在本进程中的地址，分段模式下每次init新建，拷贝出来的表共用
     std::string err_msg_;
 };
 
-template<typename T, typename Compare>
-bool SkipList<T, Compare>::init(void* mem, size_t mem_size, uint32_t max_sl_len, bool is_raw)
+template<typename T, typename Compare, typename Traits>
+bool SkipList<T, Compare, Traits>::init(void* mem, size_t mem_size, uint32_t max_sl_len, bool is_raw, size_t arena_size)
 {
     if(!mem)
     {
@@ -249,15 +933,46 @@ bool SkipList<T, Compare>::init(void* mem, size_t mem_size, uint32_t max_sl_len,
         return false;
     }
 
-    if(mem_size < max_mem_size(max_sl_len))
+    if(Traits::SEGMENTED)
     {
-        err_msg_ = "mem_size not enough";
+        segment_map_ = std::make_shared<SegmentMap>();
+        for(int i = 0; i < SL_MAX_SEGMENT_NUM; ++i)
+            segment_map_->base[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    if(arena_size && arena_size < SLArena::header_size())
+    {
+        err_msg_ = "arena_size too small";
         return false;
     }
 
-    size_t header_size = mem_header_size();
-    size_t node_size = mem_node_size();
-    mem_header_ = reinterpret_cast<MemHeader*>(mem);
+    if(is_raw && !arena_size && !std::is_trivially_copyable<T>::value && !heap_elements_)
+    {
+        err_msg_ = "non trivially copyable element requires arena_size";
+        return false;
+    }
+
+    if(mem_size < max_mem_size(max_sl_len, arena_size))
+    {
+        err_msg_ = "mem_size not enough";
+        return false;
+    }
+
+    if(Traits::SEGMENTED && mem_size > SEGMENT_MASK)
+    {// 0号段内的偏移不能占用段号的位
+        err_msg_ = "mem_size too large for segmented";
+        return false;
+    }
+
+    size_t header_size = mem_header_size(mem_size);
+    size_t node_size = mem_node_size();
+    if(header_size + (max_sl_len + 1) * node_size + ((arena_size + 7) & (~7)) > mem_size)
+    {
+        err_msg_ = "mem_size not enough";
+        return false;
+    }
+
+    mem_header_ = reinterpret_cast<MemHeader*>(mem);
     if(!is_raw)
     {// 做一下简单的校验
         if(mem_header_->magic_num != MAGIC_NUM || mem_header_->mem_size != mem_size
@@ -266,6 +981,18 @@ bool SkipList<T, Compare>::init(void* mem, size_t mem_size, uint32_t max_sl_len,
             err_msg_ = "mem header check err";
             return false;
         }
+
+        if(mem_header_->arena && !SLArena::attach(deref(mem_header_->arena), mem_size - mem_header_->arena))
+        {
+            err_msg_ = "arena check err";
+            return false;
+        }
+
+        if(!mem_header_->arena && !std::is_trivially_copyable<T>::value && !heap_elements_)
+        {
+            err_msg_ = "non trivially copyable element requires arena";
+            return false;
+        }
     }
     else
     {// 初始化内存头
@@ -277,6 +1004,18 @@ bool SkipList<T, Compare>::init(void* mem, size_t mem_size, uint32_t max_sl_len,
         mem_header_->header_size = header_size;
         mem_header_->node_size = node_size;
         mem_header_->free_list = 0;
+        mem_header_->version = 0;
+        mem_header_->init_id = sl_unique_id();
+        mem_header_->arena = 0;
+        mem_header_->dirty = Traits::TRACK_DIRTY ? (sizeof(MemHeader) + 7) & (~7) : 0;
+        mem_header_->checkpoint_seq = 0;
+        mem_header_->checkpoint_base = 0;
+        init_segments(Segmented());
+        if(arena_size)
+        {
+            mem_header_->arena = (mem_size - arena_size) & (~7);
+            SLArena::create(deref(mem_header_->arena), mem_size - mem_header_->arena);
+        }
 
         size_t node_ref = alloc_node();
         mem_header_->sl_info.head = node_ref;
@@ -286,76 +1025,137 @@ bool SkipList<T, Compare>::init(void* mem, size_t mem_size, uint32_t max_sl_len,
 
         //初始化跳跃表的头节点
         MemNode* node = reinterpret_cast<MemNode*>(deref(mem_header_->sl_info.head));
-        node->sl_node_info.backword = 0;
+        set_backword(node, 0);
         for(int i = 0; i < MAX_LEVEL_NUM; ++i)
         {
             node->sl_node_info.level[i].forward = 0;
-            node->sl_node_info.level[i].span = 0;
+            set_span(node->sl_node_info.level[i], 0);
         }
     }
 
+    // 挂接时映射其他进程已经申请的段
+    if(!map_segments()) return false;
+
     return true;
 }
 
-template<typename T, typename Compare>
-uint32_t SkipList<T, Compare>::get_index(const T& element) const
+template<typename T, typename Compare, typename Traits>
+template<typename K>
+uint32_t SkipList<T, Compare, Traits>::get_index_of(const K& key) const
+{
+    static_assert(Traits::HAS_SPAN, "get_index requires Traits::HAS_SPAN");
+
+    SL_PROBE_ENTRY(get_index_entry, mem_header_);
+    uint32_t rank = 0;
+    if(!find_first(key, rank)) rank = 0;
+    SL_PROBE_RETURN(get_index_return, mem_header_, rank);
+
+    return rank;
+}
+
+template<typename T, typename Compare, typename Traits>
+template<typename K>
+size_t SkipList<T, Compare, Traits>::find_first(const K& key, uint32_t& rank) const
 {
-    uint32_t index = 0;
-    MemNode* node = reinterpret_cast<MemNode*>(deref(mem_header_->sl_info.head));
     Compare cmp;
+    if(!Traits::TRACK_ACCESS)
+    {
+        uint32_t index[MAX_LEVEL_NUM];
+        MemNode* node = descend(key, nullptr, index);
+
+        // 高层上遇到的相同元素前面可能还有相同元素，需要下降到第0层才能确定排在最前的那个
+        size_t forward = node->sl_node_info.level[0].forward;
+        if(forward) SL_PROBE_CMP();
+        if(!forward || cmp(key, forward_key(node, 0))) return 0;
+
+        touch(forward);
+        rank = index[0] + span_of(node->sl_node_info.level[0]);
+        return forward;
+    }
+
+    // 塔高按访问次数分配时，热点元素在高层就能遇到：后继等于key，且后继在第0层的前一个节点小于key时，
+    // 后继就是排在最前的那个，不用再往下走
+    uint32_t total_span = 0;
+    MemNode* node = reinterpret_cast<MemNode*>(deref(mem_header_->sl_info.head));
     for(int i = mem_header_->sl_info.level_num - 1; i >= 0; --i)
     {
         while(node->sl_node_info.level[i].forward)
         {
-            MemNode* forward_node = reinterpret_cast<MemNode*>(deref(node->sl_node_info.level[i].forward));
-            if(cmp(forward_node->sl_node_info.element, element))
+            SL_PROBE_CMP();
+            if(cmp(forward_key(node, i), key))
             {
-                index += node->sl_node_info.level[i].span;
-                node = forward_node;
+                SL_PROBE_HOP();
+                total_span += span_of(node->sl_node_info.level[i]);
+                node = reinterpret_cast<MemNode*>(deref(node->sl_node_info.level[i].forward));
             }
             else
-            {
-                if(!cmp(element, forward_node->sl_node_info.element))
-                    return index + node->sl_node_info.level[i].span;
-                
                 break;
-            }
+        }
+
+        size_t forward = node->sl_node_info.level[i].forward;
+        if(forward) SL_PROBE_CMP();
+        if(!forward || cmp(key, forward_key(node, i))) continue;
+
+        if(i == 0 || is_first_equal(node, forward, key, HasBackword()))
+        {
+            touch(forward);
+            rank = total_span + span_of(node->sl_node_info.level[i]);
+            return forward;
         }
     }
 
     return 0;
 }
 
-template<typename T, typename Compare>
-typename SkipList<T, Compare>::Iterator SkipList<T, Compare>::find(const T& element) const
+template<typename T, typename Compare, typename Traits>
+uint32_t SkipList<T, Compare, Traits>::count_before(const T& element, bool inclusive) const
 {
+    static_assert(Traits::HAS_SPAN, "get_lower_index/get_upper_index require Traits::HAS_SPAN");
+
+    if(!inclusive)
+    {
+        uint32_t index[MAX_LEVEL_NUM];
+        descend(element, nullptr, index);
+        return index[0];
+    }
+
+    uint32_t index = 0;
     MemNode* node = reinterpret_cast<MemNode*>(deref(mem_header_->sl_info.head));
     Compare cmp;
     for(int i = mem_header_->sl_info.level_num - 1; i >= 0; --i)
     {
         while(node->sl_node_info.level[i].forward)
         {
-            MemNode* forward_node = reinterpret_cast<MemNode*>(deref(node->sl_node_info.level[i].forward));
-            if(cmp(forward_node->sl_node_info.element, element))
+            if(!cmp(element, forward_key(node, i)))
             {
-                node = forward_node;
+                index += span_of(node->sl_node_info.level[i]);
+                node = reinterpret_cast<MemNode*>(deref(node->sl_node_info.level[i].forward));
             }
             else
-            {
-                if(!cmp(element, forward_node->sl_node_info.element))
-                    return Iterator(this, node->sl_node_info.level[i].forward);
-
                 break;
-            }
         }
     }
 
-    return Iterator(this, 0);
+    return index;
+}
+
+template<typename T, typename Compare, typename Traits>
+template<typename K>
+typename SkipList<T, Compare, Traits>::Iterator SkipList<T, Compare, Traits>::find_of(const K& key) const
+{
+    SL_PROBE_ENTRY(find_entry, mem_header_);
+    uint32_t rank = 0;
+    size_t node_ref = find_first(key, rank);
+    SL_PROBE_RETURN(find_return, mem_header_, node_ref != 0);
+
+    return Iterator(this, node_ref);
 }
 
-template<typename T, typename Compare>
-typename SkipList<T, Compare>::Iterator SkipList<T, Compare>::find(uint32_t index) const
+template<typename T, typename Compare, typename Traits>
+typename SkipList<T, Compare, Traits>::Iterator SkipList<T, Compare, Traits>::find(uint32_t index) const
 {
+    static_assert(Traits::HAS_SPAN, "find(index) requires Traits::HAS_SPAN");
+
     uint32_t total_span = 0;
     MemNode* node = reinterpret_cast<MemNode*>(deref(mem_header_->sl_info.head));
     for(int i = mem_header_->sl_info.level_num - 1; i >= 0; --i)
@@ -363,128 +1163,569 @@ typename SkipList<T, Compare>::Iterator SkipList<T, Compare>::find(uint32_t inde
         while(node->sl_node_info.level[i].forward)
         {
             MemNode* forward_node = reinterpret_cast<MemNode*>(deref(node->sl_node_info.level[i].forward));
-            if(total_span + node->sl_node_info.level[i].span <= index)
+            if(total_span + span_of(node->sl_node_info.level[i]) <= index)
             {
-                total_span += node->sl_node_info.level[i].span;
+                total_span += span_of(node->sl_node_info.level[i]);
                 node = forward_node;
             }
             else
-            {
-                if(total_span == index && ref(node) != mem_header_->sl_info.head)
-                    return Iterator(this, ref(node));
-
                 break;
-            }
         }
+
+        if(total_span == index && ref(node) != mem_header_->sl_info.head)
+            return Iterator(this, ref(node));
     }
 
     return Iterator(this, 0);
 }
 
-template<typename T, typename Compare>
-bool SkipList<T, Compare>::insert(const T& element)
+template<typename T, typename Compare, typename Traits>
+template<typename K>
+typename SkipList<T, Compare, Traits>::Iterator SkipList<T, Compare, Traits>::lower_bound_of(const K& key) const
 {
+    MemNode* node = descend(key, nullptr, nullptr);
+    return Iterator(this, node->sl_node_info.level[0].forward);
+}
+
+template<typename T, typename Compare, typename Traits>
+bool SkipList<T, Compare, Traits>::insert(const T& element)
+{
+    SL_PROBE_ENTRY(insert_entry, mem_header_);
     size_t new_node_ref = alloc_node();
-    if(!new_node_ref) return false;
+    if(!new_node_ref)
+    {
+        SL_PROBE_RETURN_LEVEL(insert_return, mem_header_, false, 0);
+        return false;
+    }
 
-    uint32_t index[MAX_LEVEL_NUM] = {0};
-    size_t update[MAX_LEVEL_NUM] = {0};
-    MemNode* node = reinterpret_cast<MemNode*>(deref(mem_header_->sl_info.head));
-    Compare cmp;
-    for(int i = mem_header_->sl_info.level_num - 1; i >= 0; --i)
+    MemNode* new_node = reinterpret_cast<MemNode*>(deref(new_node_ref));
+    try
     {
-        index[i] = i == mem_header_->sl_info.level_num - 1 ? 0 : index[i + 1];
-        while(node->sl_node_info.level[i].forward)
-        {
-            MemNode* forward_node = reinterpret_cast<MemNode*>(deref(node->sl_node_info.level[i].forward));
-            if(cmp(forward_node->sl_node_info.element, element))
-            {
-                index[i] += node->sl_node_info.level[i].span;
-                node = forward_node;
-            }
-            else
-                break;
-        }
-        update[i] = ref(node);
+        SLArenaScope scope(arena());
+        new(&new_node->sl_node_info.element) T(element);
     }
+    catch(const std::bad_alloc&)
+    {
+        release_node(new_node_ref);
+        err_msg_ = "arena not enough";
+        SL_PROBE3(alloc_fail, mem_header_, arena() ? arena()->alloc_size() : 0, arena() ? arena()->mem_size() : 0);
+        SL_PROBE_RETURN_LEVEL(insert_return, mem_header_, false, 0);
+        return false;
+    }
+
+    int level = link_node(new_node_ref);
 
-    int level = random_level();
+    SL_PROBE_RETURN_LEVEL(insert_return, mem_header_, true, level);
+    return true;
+}
+
+template<typename T, typename Compare, typename Traits>
+int SkipList<T, Compare, Traits>::link_node(size_t new_node_ref, bool count, int level)
+{
+    MemNode* new_node = reinterpret_cast<MemNode*>(deref(new_node_ref));
+    uint32_t index[MAX_LEVEL_NUM] = {0};
+    size_t update[MAX_LEVEL_NUM] = {0};
+    descend(new_node->sl_node_info.element, update, index);
+
+    if(!level) level = random_level();
     if(level > mem_header_->sl_info.level_num)
     {
+        uint32_t length = count || !Traits::HAS_SPAN ? mem_header_->sl_info.length : span_length();
         for(int i = mem_header_->sl_info.level_num; i < level; ++i)
         {
             index[i] = 0;
             update[i] = mem_header_->sl_info.head;
             MemNode* update_node = reinterpret_cast<MemNode*>(deref(update[i]));
-            update_node->sl_node_info.level[i].span = mem_header_->sl_info.length;
+            set_span(update_node->sl_node_info.level[i], length);
         }
+        SL_PROBE3(level_change, mem_header_, mem_header_->sl_info.level_num, level);
         mem_header_->sl_info.level_num = level;
     }
 
-    MemNode* new_node = reinterpret_cast<MemNode*>(deref(new_node_ref));
     for(int i = 0; i < level; ++i)
     {
         MemNode* update_node = reinterpret_cast<MemNode*>(deref(update[i]));
-        new_node->sl_node_info.level[i].forward = update_node->sl_node_info.level[i].forward;
-        update_node->sl_node_info.level[i].forward = new_node_ref;
-        new_node->sl_node_info.level[i].span = update_node->sl_node_info.level[i].span - (index[0] - index[i]);
-        update_node->sl_node_info.level[i].span = index[0] - index[i] + 1; 
+        set_forward(new_node, i, update_node->sl_node_info.level[i].forward);
+        set_forward(update_node, i, new_node_ref);
+        set_span(new_node->sl_node_info.level[i], span_of(update_node->sl_node_info.level[i]) - (index[0] - index[i]));
+        set_span(update_node->sl_node_info.level[i], index[0] - index[i] + 1);
     }
 
     for(int i = level; i < mem_header_->sl_info.level_num; ++i)
     {
         MemNode* update_node = reinterpret_cast<MemNode*>(deref(update[i]));
-        update_node->sl_node_info.level[i].span += 1;
+        set_span(update_node->sl_node_info.level[i], span_of(update_node->sl_node_info.level[i]) + 1);
     }
 
     if(update[0] == mem_header_->sl_info.head)
-        new_node->sl_node_info.backword = 0;
+        set_backword(new_node, 0);
     else
-        new_node->sl_node_info.backword = update[0];
-    
+        set_backword(new_node, update[0]);
+
     if(new_node->sl_node_info.level[0].forward)
     {
         MemNode* forward_node = reinterpret_cast<MemNode*>(deref(new_node->sl_node_info.level[0].forward));
-        forward_node->sl_node_info.backword = new_node_ref;
+        set_backword(forward_node, new_node_ref);
     }
     else
         mem_header_->sl_info.tail = new_node_ref;
     
-    new_node->sl_node_info.element = element;
-    mem_header_->sl_info.length += 1;
+    if(count)
+    {
+        mem_header_->sl_info.length += 1;
+        mem_header_->version += 1;
+    }
+
+    for(int i = 0; i < mem_header_->sl_info.level_num; ++i)
+        mark_node_dirty(update[i]);
+    if(new_node->sl_node_info.level[0].forward) mark_node_dirty(new_node->sl_node_info.level[0].forward);
+
+    // 新节点插在update节点后面，各层update节点的位置索引不变，路径在新版本上仍然有效
+    if(finger_cache_) save_finger(update, index);
+
+    return level;
+}
+
+template<typename T, typename Compare, typename Traits>
+uint32_t SkipList<T, Compare, Traits>::span_length() const
+{
+    // 任何一层上从头节点到表尾的跨度之和都等于表长
+    uint32_t length = 0;
+    int top = mem_header_->sl_info.level_num - 1;
+    for(size_t r = mem_header_->sl_info.head; r; )
+    {
+        const MemNode* node = reinterpret_cast<const MemNode*>(deref(r));
+        length += span_of(node->sl_node_info.level[top]);
+        r = node->sl_node_info.level[top].forward;
+    }
+
+    return length;
+}
+
+template<typename T, typename Compare, typename Traits>
+template<typename InputIt>
+bool SkipList<T, Compare, Traits>::insert_bulk(InputIt first, InputIt last, int thread_num, SLBulkPath* path)
+{
+    if(path) *path = SL_BULK_NONE;
+
+    // 先把所有元素放进节点，中途空间不足时全部退回，表保持不变
+    std::vector<MemNode*> nodes;
+    for(; first != last; ++first)
+    {
+        size_t new_node_ref = alloc_node();
+        if(!new_node_ref)
+        {
+            err_msg_ = "mem not enough";
+            for(size_t i = 0; i < nodes.size(); ++i)
+                free_node(ref(nodes[i]));
+            return false;
+        }
+
+        MemNode* new_node = reinterpret_cast<MemNode*>(deref(new_node_ref));
+        try
+        {
+            SLArenaScope scope(arena());
+            new(&new_node->sl_node_info.element) T(*first);
+        }
+        catch(const std::bad_alloc&)
+        {
+            release_node(new_node_ref);
+            for(size_t i = 0; i < nodes.size(); ++i)
+                free_node(ref(nodes[i]));
+            err_msg_ = "arena not enough";
+            SL_PROBE3(alloc_fail, mem_header_, arena() ? arena()->alloc_size() : 0, arena() ? arena()->mem_size() : 0);
+            return false;
+        }
+
+        nodes.push_back(new_node);
+    }
+
+    if(nodes.empty()) return true;
+
+    sort_nodes(nodes, thread_num);
+
+    // 逐个插入时每个元素约下降log_P(n / m) + 1层，每层前进约P / 2步，每步是一次随机访问；
+    // 归并沿第0层把n + m个节点各走一遍，节点在内存中同样是分散的，但多数只读不写，实测每个节点约为前者一步的0.6倍
+    uint64_t n = mem_header_->sl_info.length;
+    uint64_t m = nodes.size();
+    uint64_t depth = 1;
+    for(uint64_t gap = n / m; gap >= static_cast<uint64_t>(SKIPLIST_P); gap /= SKIPLIST_P)
+        ++depth;
+
+    if(m * depth * (SKIPLIST_P / 2) * BULK_MERGE_COST_DIV < (n + m) * BULK_MERGE_COST_MUL)
+    {// 按升序插入时上一次的插入路径正好是下一次下降的起点，临时打开查找路径缓存
+        bool finger_cache = finger_cache_;
+        finger_cache_ = true;
+        for(size_t i = 0; i < nodes.size(); ++i)
+            link_node(ref(nodes[i]));
+        finger_cache_ = finger_cache;
+
+        if(path) *path = SL_BULK_FINGER;
+        SL_PROBE3(insert_bulk, mem_header_, SL_BULK_FINGER, m);
+    }
+    else
+    {
+        merge_nodes(nodes);
+        if(path) *path = SL_BULK_MERGE;
+        SL_PROBE3(insert_bulk, mem_header_, SL_BULK_MERGE, m);
+    }
 
     return true;
 }
 
-template<typename T, typename Compare>
-uint32_t SkipList<T, Compare>::erase(const T& element)
+template<typename T, typename Compare, typename Traits>
+void SkipList<T, Compare, Traits>::sort_nodes(std::vector<MemNode*>& nodes, int thread_num)
 {
+    auto node_less = [](const MemNode* a, const MemNode* b) {
+        return Compare()(a->sl_node_info.element, b->sl_node_info.element);
+    };
+
+    // 每个线程至少排BULK_SORT_GRAIN个，线程数取2的幂便于两两归并
+    int max_thread_num = 1;
+    while(max_thread_num * 2 <= thread_num && nodes.size() >= BULK_SORT_GRAIN * max_thread_num * 2)
+        max_thread_num *= 2;
+    thread_num = max_thread_num;
+
+    std::vector<size_t> bound(thread_num + 1);
+    for(int t = 0; t <= thread_num; ++t)
+        bound[t] = nodes.size() * t / thread_num;
+
+    auto sort_part = [&nodes, &bound, &node_less](int t) {
+        std::sort(nodes.begin() + bound[t], nodes.begin() + bound[t + 1], node_less);
+    };
+
+    std::vector<std::thread> threads;
+    for(int t = 1; t < thread_num; ++t)
+        threads.emplace_back(sort_part, t);
+    sort_part(0);
+    for(size_t t = 0; t < threads.size(); ++t)
+        threads[t].join();
+
+    // 每轮把相邻两段归并成一段，各对之间并行
+    for(int step = 1; step < thread_num; step *= 2)
+    {
+        auto merge_part = [&nodes, &bound, &node_less, step](int t) {
+            std::inplace_merge(nodes.begin() + bound[t], nodes.begin() + bound[t + step],
+                nodes.begin() + bound[t + step * 2], node_less);
+        };
+
+        threads.clear();
+        for(int t = step * 2; t < thread_num; t += step * 2)
+            threads.emplace_back(merge_part, t);
+        merge_part(0);
+        for(size_t t = 0; t < threads.size(); ++t)
+            threads[t].join();
+    }
+}
+
+template<typename T, typename Compare, typename Traits>
+void SkipList<T, Compare, Traits>::merge_nodes(const std::vector<MemNode*>& nodes)
+{
+    // 原有的各层最后一个节点，它们的后继为空，要靠这个判断塔高
+    int old_level_num = mem_header_->sl_info.level_num;
+    size_t level_tail[MAX_LEVEL_NUM] = {0};
+    MemNode* node = reinterpret_cast<MemNode*>(deref(mem_header_->sl_info.head));
+    for(int i = old_level_num - 1; i >= 0; --i)
+    {
+        while(node->sl_node_info.level[i].forward)
+            node = reinterpret_cast<MemNode*>(deref(node->sl_node_info.level[i].forward));
+        level_tail[i] = ref(node);
+    }
+
+    size_t last[MAX_LEVEL_NUM];                 // 每层目前最后一个节点
+    uint32_t last_rank[MAX_LEVEL_NUM];          // 上述节点的位置索引
+    for(int i = 0; i < MAX_LEVEL_NUM; ++i)
+    {
+        last[i] = mem_header_->sl_info.head;
+        last_rank[i] = 0;
+    }
+
+    // 按归并后的顺序走一遍：原有节点保持塔高，新节点随机塔高，各层从该层目前最后一个节点接过来
+    // 只在链接或跨度变化时写节点，表中没有变化的部分不会被弄脏
+    Compare cmp;
+    int level_num = 1;
+    uint32_t rank = 0;
+    size_t cur_ref = reinterpret_cast<MemNode*>(deref(last[0]))->sl_node_info.level[0].forward;
+    for(size_t j = 0; cur_ref || j < nodes.size(); )
+    {
+        MemNode* cur = cur_ref ? reinterpret_cast<MemNode*>(deref(cur_ref)) : nullptr;
+        size_t r;
+        int level;
+        if(j < nodes.size() && (!cur || !cmp(cur->sl_node_info.element, nodes[j]->sl_node_info.element)))
+        {// 新节点排在表中相同的元素前面
+            node = nodes[j++];
+            r = ref(node);
+            level = random_level();
+        }
+        else
+        {
+            node = cur;
+            r = cur_ref;
+            cur_ref = cur->sl_node_info.level[0].forward;
+            level = 1;
+            while(level < old_level_num && (node->sl_node_info.level[level].forward || level_tail[level] == r))
+                ++level;
+        }
+
+        ++rank;
+        if(level > level_num) level_num = level;
+
+        size_t prev = last[0];
+        for(int i = 0; i < level; ++i)
+        {
+            MemNode* last_node = reinterpret_cast<MemNode*>(deref(last[i]));
+            if(last_node->sl_node_info.level[i].forward != r
+                || (Traits::HAS_SPAN && span_of(last_node->sl_node_info.level[i]) != rank - last_rank[i]))
+            {
+                set_forward(last_node, i, r);
+                set_span(last_node->sl_node_info.level[i], rank - last_rank[i]);
+                mark_node_dirty(last[i]);
+            }
+            last[i] = r;
+            last_rank[i] = rank;
+        }
+
+        size_t backword = prev == mem_header_->sl_info.head ? 0 : prev;
+        if(backword_of(node) != backword)
+        {
+            set_backword(node, backword);
+            mark_node_dirty(r);
+        }
+    }
+
+    // 各层最后一个节点后面为空，跨度为到表尾的距离，不超过原层数的层上节点的链接本来就是空的
+    mem_header_->sl_info.length = rank;
+    for(int i = 0; i < std::max(level_num, old_level_num); ++i)
+    {
+        MemNode* last_node = reinterpret_cast<MemNode*>(deref(last[i]));
+        uint32_t span = i < level_num ? rank - last_rank[i] : 0;
+        if(last_node->sl_node_info.level[i].forward || (Traits::HAS_SPAN && span_of(last_node->sl_node_info.level[i]) != span))
+        {
+            last_node->sl_node_info.level[i].forward = 0;
+            set_span(last_node->sl_node_info.level[i], span);
+            mark_node_dirty(last[i]);
+        }
+    }
+
+    if(level_num != old_level_num)
+        SL_PROBE3(level_change, mem_header_, old_level_num, level_num);
+    mem_header_->sl_info.tail = last[0];
+    mem_header_->sl_info.level_num = level_num;
+    mem_header_->version += 1;
+    mark_header_dirty();
+}
+
+template<typename T, typename Compare, typename Traits>
+uint32_t SkipList<T, Compare, Traits>::erase(const T& element)
+{
+    SL_PROBE_ENTRY(erase_entry, mem_header_);
     uint32_t count = 0;
     while(del_first_of(element))
         ++count;
-    
+    SL_PROBE_RETURN(erase_return, mem_header_, count);
+
     return count;
 }
 
-template<typename T, typename Compare>
-bool SkipList<T, Compare>::del_first_of(const T& element)
+template<typename T, typename Compare, typename Traits>
+template<typename Pred>
+uint32_t SkipList<T, Compare, Traits>::erase_if(Pred pred)
 {
-    size_t update[MAX_LEVEL_NUM] = {0};
-    MemNode* node = reinterpret_cast<MemNode*>(deref(mem_header_->sl_info.head));
+    size_t update[MAX_LEVEL_NUM];
+    uint32_t index[MAX_LEVEL_NUM];
+    for(int i = 0; i < mem_header_->sl_info.level_num; ++i)
+    {
+        update[i] = mem_header_->sl_info.head;
+        index[i] = 0;
+    }
+
+    return erase_walk(update, index, [](const T&) { return false; }, pred);
+}
+
+template<typename T, typename Compare, typename Traits>
+template<typename Pred>
+uint32_t SkipList<T, Compare, Traits>::erase_if(const T& lo, const T& hi, Pred pred)
+{
+    size_t update[MAX_LEVEL_NUM];
+    uint32_t index[MAX_LEVEL_NUM];
+    descend(lo, update, index);
+
     Compare cmp;
-    for(int i = mem_header_->sl_info.level_num - 1; i >= 0; --i)
+    return erase_walk(update, index, [&cmp, &hi](const T& element) { return cmp(hi, element); }, pred);
+}
+
+template<typename T, typename Compare, typename Traits>
+template<typename Stop, typename Pred>
+uint32_t SkipList<T, Compare, Traits>::erase_walk(const size_t* update, const uint32_t* index, Stop stop, Pred pred)
+{
+    // last为每层最后一个保留的节点，last_rank为它删除之后的位置索引
+    // next为每层下一个还没走到的节点，next_rank为它删除之前的位置索引；走到的节点r在第i层上当且仅当next[i] == r
+    int level_num = mem_header_->sl_info.level_num;
+    size_t last[MAX_LEVEL_NUM];
+    uint32_t last_rank[MAX_LEVEL_NUM];
+    size_t next[MAX_LEVEL_NUM];
+    uint32_t next_rank[MAX_LEVEL_NUM];
+    for(int i = 0; i < level_num; ++i)
     {
-        while(node->sl_node_info.level[i].forward)
+        MemNode* node = reinterpret_cast<MemNode*>(deref(update[i]));
+        last[i] = update[i];
+        last_rank[i] = index[i];
+        next[i] = node->sl_node_info.level[i].forward;
+        next_rank[i] = index[i] + span_of(node->sl_node_info.level[i]);
+    }
+
+    uint32_t count = 0;
+    uint32_t rank = index[0];
+
+    // stop或pred抛出异常时也要执行，否则已经释放的节点还挂在表中
+    auto relink = [&]() {
+        // 各层最后一个保留的节点接到走过的范围之后的第一个节点，它之后的节点位置索引都减少count
+        uint32_t length = mem_header_->sl_info.length - count;
+        for(int i = 0; i < level_num; ++i)
         {
-            MemNode* forward_node = reinterpret_cast<MemNode*>(deref(node->sl_node_info.level[i].forward));
-            if(cmp(forward_node->sl_node_info.element, element))
-                node = forward_node;
+            MemNode* last_node = reinterpret_cast<MemNode*>(deref(last[i]));
+            uint32_t span = next[i] ? next_rank[i] - count - last_rank[i] : length - last_rank[i];
+            if(last_node->sl_node_info.level[i].forward != next[i]
+                || (Traits::HAS_SPAN && span_of(last_node->sl_node_info.level[i]) != span))
+            {
+                set_forward(last_node, i, next[i]);
+                set_span(last_node->sl_node_info.level[i], span);
+                mark_node_dirty(last[i]);
+            }
+        }
+
+        size_t prev = last[0] == mem_header_->sl_info.head ? 0 : last[0];
+        if(next[0])
+        {
+            MemNode* next_node = reinterpret_cast<MemNode*>(deref(next[0]));
+            if(backword_of(next_node) != prev)
+            {
+                set_backword(next_node, prev);
+                mark_node_dirty(next[0]);
+            }
+        }
+        else
+            mem_header_->sl_info.tail = prev;
+
+        MemNode* head = reinterpret_cast<MemNode*>(deref(mem_header_->sl_info.head));
+        while(mem_header_->sl_info.level_num > 1 && head->sl_node_info.level[mem_header_->sl_info.level_num - 1].forward == 0)
+            mem_header_->sl_info.level_num -= 1;
+        if(mem_header_->sl_info.level_num != level_num)
+            SL_PROBE3(level_change, mem_header_, level_num, mem_header_->sl_info.level_num);
+
+        mem_header_->sl_info.length = length;
+        mem_header_->version += 1;
+        mark_header_dirty();
+    };
+
+    try
+    {
+        for(size_t r = next[0]; r; )
+        {
+            MemNode* node = reinterpret_cast<MemNode*>(deref(r));
+            if(stop(node->sl_node_info.element)) break;
+
+            ++rank;
+            size_t forward = node->sl_node_info.level[0].forward;
+            if(pred(node->sl_node_info.element))
+            {// 删除的节点不接进任何一层，各层的next越过它
+                for(int i = 0; i < level_num && next[i] == r; ++i)
+                {
+                    next[i] = node->sl_node_info.level[i].forward;
+                    next_rank[i] = rank + span_of(node->sl_node_info.level[i]);
+                }
+
+                free_node(r);
+                ++count;
+            }
+            else if(count)
+            {// 前面有节点被删除，保留的节点接到各层最后一个保留的节点后面，没有变化的链接不写
+                uint32_t new_rank = rank - count;
+                size_t prev = last[0];
+                for(int i = 0; i < level_num && next[i] == r; ++i)
+                {
+                    MemNode* last_node = reinterpret_cast<MemNode*>(deref(last[i]));
+                    if(last_node->sl_node_info.level[i].forward != r
+                        || (Traits::HAS_SPAN && span_of(last_node->sl_node_info.level[i]) != new_rank - last_rank[i]))
+                    {
+                        set_forward(last_node, i, r);
+                        set_span(last_node->sl_node_info.level[i], new_rank - last_rank[i]);
+                        mark_node_dirty(last[i]);
+                    }
+                    last[i] = r;
+                    last_rank[i] = new_rank;
+                    next[i] = node->sl_node_info.level[i].forward;
+                    next_rank[i] = rank + span_of(node->sl_node_info.level[i]);
+                }
+
+                size_t backword = prev == mem_header_->sl_info.head ? 0 : prev;
+                if(backword_of(node) != backword)
+                {
+                    set_backword(node, backword);
+                    mark_node_dirty(r);
+                }
+            }
             else
-                break;
+            {// 还没有删除过节点，链接都不变
+                for(int i = 0; i < level_num && next[i] == r; ++i)
+                {
+                    last[i] = r;
+                    last_rank[i] = rank;
+                    next[i] = node->sl_node_info.level[i].forward;
+                    next_rank[i] = rank + span_of(node->sl_node_info.level[i]);
+                }
+            }
+
+            r = forward;
         }
-        update[i] = ref(node);
     }
+    catch(...)
+    {// 异常节点之前的部分都已处理完，当作在这个节点处停下，接好各层再抛出
+        if(count) relink();
+        throw;
+    }
+
+    SL_PROBE3(erase_if, mem_header_, count, rank - index[0]);
+    if(!count) return 0;
+
+    relink();
+    return count;
+}
+
+template<typename T, typename Compare, typename Traits>
+void SkipList<T, Compare, Traits>::clear()
+{
+    MemNode* head = reinterpret_cast<MemNode*>(deref(mem_header_->sl_info.head));
+    for(size_t r = head->sl_node_info.level[0].forward; r; )
+    {
+        size_t next = reinterpret_cast<MemNode*>(deref(r))->sl_node_info.level[0].forward;
+        free_node(r);
+        r = next;
+    }
+
+    for(int i = 0; i < MAX_LEVEL_NUM; ++i)
+    {
+        head->sl_node_info.level[i].forward = 0;
+        set_span(head->sl_node_info.level[i], 0);
+    }
+
+    if(mem_header_->sl_info.level_num != 1)
+        SL_PROBE3(level_change, mem_header_, mem_header_->sl_info.level_num, 1);
+    mem_header_->sl_info.tail = 0;
+    mem_header_->sl_info.level_num = 1;
+    mem_header_->sl_info.length = 0;
+    mem_header_->version += 1;
+    mark_node_dirty(mem_header_->sl_info.head);
+    mark_header_dirty();
+}
 
+template<typename T, typename Compare, typename Traits>
+bool SkipList<T, Compare, Traits>::del_first_of(const T& element, size_t* unlinked)
+{
+    size_t update[MAX_LEVEL_NUM] = {0};
+    uint32_t index[MAX_LEVEL_NUM] = {0};
+    MemNode* node = descend(element, update, index);
+    Compare cmp;
     if(node->sl_node_info.level[0].forward)
     {
         MemNode* forward_node = reinterpret_cast<MemNode*>(deref(node->sl_node_info.level[0].forward));
@@ -498,33 +1739,51 @@ bool SkipList<T, Compare>::del_first_of(const T& element)
                 MemNode* update_node = reinterpret_cast<MemNode*>(deref(update[i]));
                 if(update_node->sl_node_info.level[i].forward == del_node_ref)
                 {
-                    update_node->sl_node_info.level[i].span += del_node->sl_node_info.level[i].span;
-                    update_node->sl_node_info.level[i].span -= 1;
-                    update_node->sl_node_info.level[i].forward = del_node->sl_node_info.level[i].forward;
+                    set_span(update_node->sl_node_info.level[i],
+                        span_of(update_node->sl_node_info.level[i]) + span_of(del_node->sl_node_info.level[i]) - 1);
+                    set_forward(update_node, i, del_node->sl_node_info.level[i].forward);
                 }
                 else
                 {
-                    update_node->sl_node_info.level[i].span -= 1;
+                    set_span(update_node->sl_node_info.level[i], span_of(update_node->sl_node_info.level[i]) - 1);
                 }
             }
 
+            // 被删节点的前一个节点就是第0层的update节点，不依赖backword
+            size_t prev = update[0] == mem_header_->sl_info.head ? 0 : update[0];
             if(del_node->sl_node_info.level[0].forward)
             {
                 forward_node = reinterpret_cast<MemNode*>(deref(del_node->sl_node_info.level[0].forward));
-                forward_node->sl_node_info.backword = del_node->sl_node_info.backword;
+                set_backword(forward_node, prev);
+                mark_node_dirty(del_node->sl_node_info.level[0].forward);
             }
             else
-                mem_header_->sl_info.tail = del_node->sl_node_info.backword;
+                mem_header_->sl_info.tail = prev;
+
+            for(int i = 0; i < mem_header_->sl_info.level_num; ++i)
+                mark_node_dirty(update[i]);
             
             node = reinterpret_cast<MemNode*>(deref(mem_header_->sl_info.head));
+            int old_level_num = mem_header_->sl_info.level_num;
             while(mem_header_->sl_info.level_num > 1 
                 && node->sl_node_info.level[mem_header_->sl_info.level_num - 1].forward == 0)
             {
                 mem_header_->sl_info.level_num -= 1;
             }
+            if(mem_header_->sl_info.level_num != old_level_num)
+                SL_PROBE3(level_change, mem_header_, old_level_num, mem_header_->sl_info.level_num);
             
-            mem_header_->sl_info.length -= 1;
-            free_node(del_node_ref);
+            if(unlinked)
+                *unlinked = del_node_ref;
+            else
+            {
+                mem_header_->sl_info.length -= 1;
+                mem_header_->version += 1;
+                free_node(del_node_ref);
+            }
+
+            // 删除的节点排在update节点后面，路径在新版本上仍然有效
+            if(finger_cache_) save_finger(update, index);
 
             return true;
         }
@@ -533,33 +1792,564 @@ bool SkipList<T, Compare>::del_first_of(const T& element)
     return false;
 }
 
-template<typename T, typename Compare>
-size_t SkipList<T, Compare>::alloc_node()
+template<typename T, typename Compare, typename Traits>
+template<typename K>
+typename SkipList<T, Compare, Traits>::MemNode* SkipList<T, Compare, Traits>::descend(const K& key, size_t* update, uint32_t* index) const
+{
+    size_t update_buf[MAX_LEVEL_NUM];
+    uint32_t index_buf[MAX_LEVEL_NUM];
+    if(!update) update = update_buf;
+    if(!index) index = index_buf;
+
+    int level_num = mem_header_->sl_info.level_num;
+    int top = level_num - 1;
+    uint32_t total_span = 0;
+    MemNode* node = reinterpret_cast<MemNode*>(deref(mem_header_->sl_info.head));
+    Compare cmp;
+
+    const SLFinger& cache = finger();
+    if(finger_cache_ && cache.owner == mem_header_ && cache.init_id == mem_header_->init_id
+        && cache.version == mem_header_->version && cache.level_num == level_num)
+    {// 第i层缓存的节点小于key，且其后继不小于key时，它就是本次下降在第i层停下的节点
+     // 而更高层缓存的节点在上一次下降时先于它到达，同样夹住key，可以直接沿用
+        for(int i = 0; i < level_num; ++i)
+        {
+            MemNode* cache_node = reinterpret_cast<MemNode*>(deref(cache.update[i]));
+            if(cache.update[i] != mem_header_->sl_info.head && !cmp(cache_node->sl_node_info.element, key))
+                continue;
+
+            if(cache_node->sl_node_info.level[i].forward && cmp(forward_key(cache_node, i), key))
+                continue;
+
+            for(int j = i; j < level_num; ++j)
+            {
+                update[j] = cache.update[j];
+                index[j] = cache.index[j];
+            }
+            node = cache_node;
+            total_span = cache.index[i];
+            top = i - 1;
+            break;
+        }
+    }
+
+    for(int i = top; i >= 0; --i)
+    {
+        while(node->sl_node_info.level[i].forward)
+        {
+            SL_PROBE_CMP();
+            if(cmp(forward_key(node, i), key))
+            {
+                SL_PROBE_HOP();
+                total_span += span_of(node->sl_node_info.level[i]);
+                node = reinterpret_cast<MemNode*>(deref(node->sl_node_info.level[i].forward));
+            }
+            else
+                break;
+        }
+        update[i] = ref(node);
+        index[i] = total_span;
+    }
+
+    if(finger_cache_) save_finger(update, index);
+
+    return node;
+}
+
+template<typename T, typename Compare, typename Traits>
+void SkipList<T, Compare, Traits>::save_finger(const size_t* update, const uint32_t* index) const
+{
+    SLFinger& cache = finger();
+    cache.owner = mem_header_;
+    cache.init_id = mem_header_->init_id;
+    cache.version = mem_header_->version;
+    cache.level_num = mem_header_->sl_info.level_num;
+    memcpy(cache.update, update, sizeof(size_t) * cache.level_num);
+    memcpy(cache.index, index, sizeof(uint32_t) * cache.level_num);
+}
+
+template<typename T, typename Compare, typename Traits>
+void SkipList<T, Compare, Traits>::rebalance()
+{
+    relink([](uint32_t rank, MemNode*) {
+        int level = 1;
+        for(; rank % SKIPLIST_P == 0 && level < MAX_LEVEL_NUM; rank /= SKIPLIST_P)
+            ++level;
+
+        return level;
+    });
+}
+
+template<typename T, typename Compare, typename Traits>
+void SkipList<T, Compare, Traits>::rebalance_by_access()
+{
+    static_assert(Traits::TRACK_ACCESS, "rebalance_by_access requires Traits::TRACK_ACCESS");
+
+    uint64_t total = 0;
+    MemNode* head = reinterpret_cast<MemNode*>(deref(mem_header_->sl_info.head));
+    for(size_t r = head->sl_node_info.level[0].forward; r; )
+    {
+        MemNode* node = reinterpret_cast<MemNode*>(deref(r));
+        total += node->access_count;
+        r = node->sl_node_info.level[0].forward;
+    }
+
+    uint64_t length = mem_header_->sl_info.length;
+    relink([this, total, length](uint32_t, MemNode* node) {
+        int level = random_level();
+        // 命中次数与平均值之比为ratio时，至少分配1 + log_P(ratio)层
+        uint64_t ratio = total ? node->access_count * length / total : 0;
+        for(int hot_level = 1; ratio >= SKIPLIST_P && hot_level < MAX_LEVEL_NUM; ratio /= SKIPLIST_P)
+        {
+            if(++hot_level > level) level = hot_level;
+        }
+
+        node->access_count >>= 1;
+        return level;
+    });
+}
+
+template<typename T, typename Compare, typename Traits>
+template<typename HeightFn>
+void SkipList<T, Compare, Traits>::relink(HeightFn height)
+{
+    size_t last[MAX_LEVEL_NUM];                 // 每层目前最后一个节点
+    uint32_t last_rank[MAX_LEVEL_NUM];          // 上述节点的位置索引
+    for(int i = 0; i < MAX_LEVEL_NUM; ++i)
+    {
+        last[i] = mem_header_->sl_info.head;
+        last_rank[i] = 0;
+    }
+
+    int level_num = 1;
+    uint32_t rank = 0;
+    MemNode* head = reinterpret_cast<MemNode*>(deref(mem_header_->sl_info.head));
+    for(size_t r = head->sl_node_info.level[0].forward; r; )
+    {
+        MemNode* node = reinterpret_cast<MemNode*>(deref(r));
+        ++rank;
+        int level = height(rank, node);
+        if(level < 1) level = 1;
+        if(level > MAX_LEVEL_NUM) level = MAX_LEVEL_NUM;
+        if(level > level_num) level_num = level;
+
+        // 第0层的链接不变，更高的层从该层目前最后一个节点接过来
+        for(int i = 1; i < level; ++i)
+        {
+            MemNode* last_node = reinterpret_cast<MemNode*>(deref(last[i]));
+            set_forward(last_node, i, r);
+            set_span(last_node->sl_node_info.level[i], rank - last_rank[i]);
+            last[i] = r;
+            last_rank[i] = rank;
+        }
+
+        size_t next = node->sl_node_info.level[0].forward;
+        for(int i = level; i < MAX_LEVEL_NUM; ++i)
+        {
+            node->sl_node_info.level[i].forward = 0;
+            set_span(node->sl_node_info.level[i], 0);
+        }
+
+        r = next;
+    }
+
+    // 各层最后一个节点后面为空，跨度为到表尾的距离
+    for(int i = 1; i < MAX_LEVEL_NUM; ++i)
+    {
+        MemNode* last_node = reinterpret_cast<MemNode*>(deref(last[i]));
+        last_node->sl_node_info.level[i].forward = 0;
+        set_span(last_node->sl_node_info.level[i], i < level_num ? mem_header_->sl_info.length - last_rank[i] : 0);
+    }
+
+    SL_PROBE3(level_change, mem_header_, mem_header_->sl_info.level_num, level_num);
+    mem_header_->sl_info.level_num = level_num;
+    mem_header_->version += 1;
+
+    // 所有节点都可能改动
+    mark_dirty(0, mem_header_->alloc_size);
+}
+
+template<typename T, typename Compare, typename Traits>
+bool SkipList<T, Compare, Traits>::warm(SLWarmMode mode, int thread_num, bool lock, uint64_t* cost_us)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    char* base = reinterpret_cast<char*>(mem_header_);
+    bool ret = warm_range(base, base + mem_header_->alloc_size, mode, thread_num, lock);
+    if(ret && mem_header_->arena)
+    {
+        char* arena_base = base + mem_header_->arena;
+        ret = warm_range(arena_base, arena_base + arena()->alloc_size(), mode, thread_num, lock);
+    }
+
+    if(cost_us)
+    {
+        *cost_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+
+    return ret;
+}
+
+template<typename T, typename Compare, typename Traits>
+bool SkipList<T, Compare, Traits>::warm_range(char* begin, char* end, SLWarmMode mode, int thread_num, bool lock)
+{
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    char* page_begin = reinterpret_cast<char*>(reinterpret_cast<uintptr_t>(begin) & ~(page_size - 1));
+    size_t len = end - page_begin;
+
+    if(mode == SL_WARM_WILLNEED && madvise(page_begin, len, MADV_WILLNEED) != 0)
+    {
+        err_msg_ = std::string("madvise(MADV_WILLNEED) failed: ") + strerror(errno);
+        return false;
+    }
+
+#ifdef MADV_POPULATE_READ
+    if(mode == SL_WARM_POPULATE)
+    {
+        if(madvise(page_begin, len, MADV_POPULATE_READ) == 0)
+            mode = SL_WARM_WILLNEED;
+        else if(errno != EINVAL)
+        {
+            err_msg_ = std::string("madvise(MADV_POPULATE_READ) failed: ") + strerror(errno);
+            return false;
+        }
+    }
+#endif
+
+    if(mode != SL_WARM_WILLNEED)
+    {// 按页均分给各线程，每页读一个字节
+        size_t page_num = (len + page_size - 1) / page_size;
+        if(thread_num < 1) thread_num = 1;
+        if(static_cast<size_t>(thread_num) > page_num) thread_num = page_num ? static_cast<int>(page_num) : 1;
+
+        auto touch = [page_begin, page_size, page_num, thread_num](int t) {
+            volatile char sink = 0;
+            for(size_t page = page_num * t / thread_num; page < page_num * (t + 1) / thread_num; ++page)
+                sink = sink + page_begin[page * page_size];
+        };
+
+        std::vector<std::thread> threads;
+        for(int t = 1; t < thread_num; ++t)
+            threads.emplace_back(touch, t);
+        touch(0);
+        for(size_t t = 0; t < threads.size(); ++t)
+            threads[t].join();
+    }
+
+    if(lock && mlock(page_begin, len) != 0)
+    {
+        err_msg_ = std::string("mlock failed: ") + strerror(errno);
+        return false;
+    }
+
+    return true;
+}
+
+template<typename T, typename Compare, typename Traits>
+void SkipList<T, Compare, Traits>::stats(Stats& stats) const
+{
+    memset(&stats, 0, sizeof(stats));
+    stats.mem_size = mem_header_->mem_size;
+    stats.header_size = mem_header_->header_size;
+    stats.node_size = mem_header_->node_size;
+    stats.alloc_size = mem_header_->alloc_size;
+    stats.version = mem_header_->version;
+    stats.length = mem_header_->sl_info.length;
+    stats.level_num = mem_header_->sl_info.level_num;
+
+    // 表在被并发修改时链表可能暂时不完整，步数不超过节点总数，避免绕圈
+    size_t node_num = alloc_node_num();
+    for(size_t r = mem_header_->free_list; r && stats.free_num < node_num; r = reinterpret_cast<MemNode*>(deref(r))->next)
+        ++stats.free_num;
+
+    stats.fragmentation = node_num ? static_cast<double>(stats.free_num) / node_num : 0;
+
+    const MemNode* head = reinterpret_cast<const MemNode*>(deref(mem_header_->sl_info.head));
+    for(int i = 0; i < stats.level_num && i < MAX_LEVEL_NUM; ++i)
+    {
+        for(size_t r = head->sl_node_info.level[i].forward; r && stats.level_count[i] < node_num;
+            r = reinterpret_cast<MemNode*>(deref(r))->sl_node_info.level[i].forward)
+        {
+            ++stats.level_count[i];
+        }
+    }
+
+    if(mem_header_->arena)
+    {
+        stats.arena_size = arena()->mem_size();
+        stats.arena_alloc_size = arena()->alloc_size();
+        stats.arena_used_size = arena()->used_size();
+    }
+}
+
+template<typename T, typename Compare, typename Traits>
+bool SkipList<T, Compare, Traits>::checkpoint(const char* path, bool full)
+{
+    static_assert(Traits::TRACK_DIRTY, "checkpoint requires Traits::TRACK_DIRTY");
+
+    // 要写入的数据段，相邻的脏页合成一段
+    std::vector<std::pair<size_t, size_t>> ranges;
+    size_t used_end = mem_header_->alloc_size;
+    uint64_t* map = reinterpret_cast<uint64_t*>(deref(mem_header_->dirty));
+    size_t map_words = dirty_map_size(mem_header_->mem_size) / 8;
+    if(full)
+        ranges.push_back(std::make_pair(static_cast<size_t>(0), used_end));
+    else
+    {
+        mark_header_dirty();
+        for(size_t page = 0; page * DIRTY_PAGE_SIZE < used_end; ++page)
+        {
+            if(!(map[page / 64] & (static_cast<uint64_t>(1) << (page % 64)))) continue;
+
+            size_t begin = page * DIRTY_PAGE_SIZE;
+            size_t end = std::min(begin + DIRTY_PAGE_SIZE, used_end);
+            if(!ranges.empty() && ranges.back().first + ranges.back().second == begin)
+                ranges.back().second += end - begin;
+            else
+                ranges.push_back(std::make_pair(begin, end - begin));
+        }
+    }
+
+    if(mem_header_->arena)
+        ranges.push_back(std::make_pair(mem_header_->arena, arena()->alloc_size()));
+
+    if(!full && !mem_header_->checkpoint_base)
+    {
+        err_msg_ = "no full checkpoint before delta";
+        return false;
+    }
+
+    std::string tmp_path = std::string(path) + ".tmp";
+    FILE* fp = fopen(tmp_path.c_str(), "wb");
+    if(!fp)
+    {
+        err_msg_ = "open checkpoint file failed: " + tmp_path;
+        return false;
+    }
+
+    // 先清空位图、推进序号再写，写入的内存头里就是新的状态；写失败时恢复
+    std::vector<uint64_t> saved_map(map, map + map_words);
+    uint64_t saved_base = mem_header_->checkpoint_base;
+    memset(map, 0, map_words * 8);
+    mem_header_->checkpoint_seq += 1;
+    if(full) mem_header_->checkpoint_base = sl_unique_id();
+
+    SLCheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic_num = SL_CHECKPOINT_MAGIC_NUM;
+    header.full = full;
+    header.seq = mem_header_->checkpoint_seq;
+    header.base_id = mem_header_->checkpoint_base;
+    header.mem_size = mem_header_->mem_size;
+    header.node_size = mem_header_->node_size;
+    header.range_num = ranges.size();
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    for(size_t i = 0; ok && i < ranges.size(); ++i)
+    {
+        uint64_t range[2] = {ranges[i].first, ranges[i].second};
+        ok = fwrite(range, sizeof(range), 1, fp) == 1
+            && (!range[1] || fwrite(deref(range[0]), range[1], 1, fp) == 1);
+    }
+    ok = ok && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    ok = fclose(fp) == 0 && ok;
+    if(!ok) unlink(tmp_path.c_str());
+    ok = ok && rename(tmp_path.c_str(), path) == 0 && sl_sync_dir(path);
+
+    if(!ok)
+    {// 目录没有落盘时path上可能已经是新文件，按没写处理，下一次增量检查点会重新包含这些页
+        memcpy(map, &saved_map[0], map_words * 8);
+        mem_header_->checkpoint_seq -= 1;
+        mem_header_->checkpoint_base = saved_base;
+        err_msg_ = "write checkpoint failed";
+        return false;
+    }
+
+    return true;
+}
+
+template<typename T, typename Compare, typename Traits>
+bool SkipList<T, Compare, Traits>::restore(void* mem, size_t mem_size, uint32_t max_sl_len, const std::vector<std::string>& paths)
+{
+    if(!mem || paths.empty())
+    {
+        err_msg_ = "mem is nullptr or no checkpoint";
+        return false;
+    }
+
+    uint64_t seq = 0;
+    uint64_t base_id = 0;
+    for(size_t i = 0; i < paths.size(); ++i)
+    {
+        FILE* fp = fopen(paths[i].c_str(), "rb");
+        if(!fp)
+        {
+            err_msg_ = "open checkpoint file failed: " + paths[i];
+            return false;
+        }
+
+        SLCheckpointHeader header;
+        bool ok = fread(&header, sizeof(header), 1, fp) == 1 && header.magic_num == SL_CHECKPOINT_MAGIC_NUM
+            && header.mem_size == mem_size && header.node_size == mem_node_size()
+            && (i ? !header.full && header.seq == seq + 1 && header.base_id == base_id : header.full != 0);
+        for(uint64_t r = 0; ok && r < header.range_num; ++r)
+        {
+            uint64_t range[2];
+            ok = fread(range, sizeof(range), 1, fp) == 1 && range[0] <= mem_size && range[1] <= mem_size - range[0];
+            ok = ok && (!range[1] || fread(reinterpret_cast<char*>(mem) + range[0], range[1], 1, fp) == 1);
+        }
+        fclose(fp);
+
+        if(!ok)
+        {
+            err_msg_ = "checkpoint check err: " + paths[i];
+            return false;
+        }
+
+        seq = header.seq;
+        base_id = header.base_id;
+    }
+
+    return init(mem, mem_size, max_sl_len, false);
+}
+
+template<typename T, typename Compare, typename Traits>
+void* SkipList<T, Compare, Traits>::map_segment(size_t segment_id) const
+{
+    std::lock_guard<std::mutex> guard(segment_map_->mutex);
+    void* base = segment_map_->base[segment_id].load(std::memory_order_relaxed);
+    if(base) return base;
+
+    if(!segment_provider_ || segment_id >= mem_header_->segment_num) return nullptr;
+
+    base = segment_provider_(segment_id, mem_header_->segments[segment_id].size, false);
+    if(base) segment_map_->base[segment_id].store(base, std::memory_order_release);
+
+    return base;
+}
+
+template<typename T, typename Compare, typename Traits>
+bool SkipList<T, Compare, Traits>::map_segments(std::true_type)
+{
+    uint32_t segment_num = mem_header_->segment_num;
+    if(segment_num > static_cast<uint32_t>(SL_MAX_SEGMENT_NUM))
+    {
+        err_msg_ = "segment_num check err";
+        return false;
+    }
+
+    for(uint32_t i = 1; i < segment_num; ++i)
+    {
+        if(!map_segment(i))
+        {
+            err_msg_ = segment_provider_ ? "map segment " + std::to_string(i) + " failed" : "segment provider not set";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template<typename T, typename Compare, typename Traits>
+size_t SkipList<T, Compare, Traits>::alloc_segment_node(std::true_type)
+{
+    uint32_t segment_id = mem_header_->segment_num - 1;
+    size_t node_size = mem_header_->node_size;
+    if(!segment_id || mem_header_->segments[segment_id].alloc_size + node_size > mem_header_->segments[segment_id].size)
+    {// 最后一段也用完了，申请新段
+        size_t segment_size = mem_header_->segment_size;
+        if(!segment_provider_ || segment_size < node_size || segment_size > SEGMENT_MASK
+            || mem_header_->segment_num >= static_cast<uint32_t>(SL_MAX_SEGMENT_NUM))
+        {
+            return 0;
+        }
+
+        segment_id = mem_header_->segment_num;
+        void* base = segment_provider_(segment_id, segment_size, true);
+        if(!base) return 0;
+
+        segment_map_->base[segment_id].store(base, std::memory_order_release);
+        mem_header_->segments[segment_id].size = segment_size;
+        mem_header_->segments[segment_id].alloc_size = 0;
+        mem_header_->segment_num += 1;
+    }
+
+    SLSegmentInfo& segment = mem_header_->segments[segment_id];
+    size_t pos = (static_cast<size_t>(segment_id) << SEGMENT_SHIFT) | segment.alloc_size;
+    segment.alloc_size += node_size;
+
+    return pos;
+}
+
+template<typename T, typename Compare, typename Traits>
+size_t SkipList<T, Compare, Traits>::alloc_node_num() const
+{
+    size_t node_num = (mem_header_->alloc_size - mem_header_->header_size) / mem_header_->node_size;
+    alloc_segment_node_num(node_num, Segmented());
+
+    return node_num;
+}
+
+template<typename T, typename Compare, typename Traits>
+size_t SkipList<T, Compare, Traits>::alloc_node()
 {
     size_t pos = 0;
     MemNode* node = nullptr;
+    size_t node_end = mem_header_->arena ? mem_header_->arena : mem_header_->mem_size;
     if(mem_header_->free_list)
     {// 空闲链表非空，从空闲链表上申请节点
         node = reinterpret_cast<MemNode*>(deref(mem_header_->free_list));
         pos = mem_header_->free_list;
         mem_header_->free_list = node->next;
     }
-    else if(mem_header_->alloc_size + mem_header_->node_size <= mem_header_->mem_size)
+    else if(mem_header_->alloc_size + mem_header_->node_size <= node_end)
     {// 空闲链表为空且还有空间，从未使用的内存中申请节点
         node = reinterpret_cast<MemNode*>(deref(mem_header_->alloc_size));
         pos = mem_header_->alloc_size;
         mem_header_->alloc_size += mem_header_->node_size;
     }
+    else if((pos = alloc_segment_node()))
+    {// 分段模式下从其他段申请
+        node = reinterpret_cast<MemNode*>(deref(pos));
+    }
 
-    if(node) memset(node, 0, mem_header_->node_size);
+    if(!node) SL_PROBE3(alloc_fail, mem_header_, mem_header_->alloc_size, node_end);
+
+    if(node)
+    {
+        reset_node(pos);
+        mark_header_dirty();
+    }
 
     return pos;
 }
 
-template<typename T, typename Compare>
-void SkipList<T, Compare>::free_node(size_t node_ref)
+template<typename T, typename Compare, typename Traits>
+void SkipList<T, Compare, Traits>::reset_node(size_t pos)
+{
+    MemNode* node = reinterpret_cast<MemNode*>(deref(pos));
+    memset(static_cast<void*>(node), 0, mem_header_->node_size);
+    set_self_ref(node, pos);
+    mark_node_dirty(pos);
+}
+
+template<typename T, typename Compare, typename Traits>
+void SkipList<T, Compare, Traits>::free_node(size_t node_ref)
+{
+    MemNode* node = reinterpret_cast<MemNode*>(deref(node_ref));
+    node->sl_node_info.element.~T();
+    release_node(node_ref);
+}
+
+template<typename T, typename Compare, typename Traits>
+void SkipList<T, Compare, Traits>::release_node(size_t node_ref)
 {
     MemNode* node = reinterpret_cast<MemNode*>(deref(node_ref));
     node->next = mem_header_->free_list;
     mem_header_->free_list = node_ref;
+    mark_node_dirty(node_ref);
+    mark_header_dirty();
 }
+
+#endif
@@ -0,0 +1,416 @@
+/*
+ * File        : skip_list_2d.h
+ * Created Date: 2026-10-18 11:26:37
+ * Author      : philma
+ * Desc        : 基于一段连续内存的二维点集，支持 x在[a,b] 且 y在[c,d] 的范围查询
+ *               主表是按x排序的SkipList，主表节点在AUG_MIN_LEVEL及以上的每一层上，各自挂一个按y排序的SkipList，
+ *               存放该节点在这一层跨度内的所有点（类似范围树）
+ *               查询时把[a,b]拆成O(log n)段完整的跨度，每段在副表中按y查找，期望复杂度O(log² n + k)
+ *               这是一次构建的静态索引：先insert装入全部点，再build()一次，之后只查询
+ *               insert/erase不维护副表，只会让副表整体失效，失效后的查询退化为在主表上的O(n)扫描，直到再次build()
+ *               点集需要频繁修改时，应攒一批修改后再build()，或者不使用本结构
+ *
+ *               内存布局：SL2DHeader | 主表 | 节点目录(按主表节点槽位索引) | 副表区（顺序分配）
+ */
+
+#ifndef SKIP_LIST_2D_H
+#define SKIP_LIST_2D_H
+
+#include "skip_list.h"
+
+template<typename X, typename Y>
+struct SLPoint2D
+{
+    X x;
+    Y y;
+};
+
+template<typename X, typename Y, typename XCompare = std::less<X>, typename YCompare = std::less<Y>>
+class SkipList2D
+{
+public:
+    typedef SLPoint2D<X, Y> Point;
+
+    /*
+     * 初始化，mem_size至少为base_mem_size(max_len)，多出的部分用于存放副表
+     * 副表所需内存和节点的层数分布有关，max_mem_size(max_len)是最坏情况下的大小
+     */
+    bool init(void* mem, size_t mem_size, uint32_t max_len, bool is_raw = true);
+
+    /*
+     * 插入一个点，用于build()之前装入点集
+     * 不维护副表：在已build()的索引上调用会使副表整体失效，之后的查询为O(n)，直到再次build()
+     * 返回false表示插入失败，仅在空间不足的情况下发生
+     */
+    bool insert(const X& x, const Y& y);
+
+    /*
+     * 删除点，如果有多个相同的点，则均删除
+     * 和insert一样不维护副表，删除了点时副表整体失效，之后的查询为O(n)，直到再次build()
+     * 返回删除的点个数
+     */
+    uint32_t erase(const X& x, const Y& y);
+
+    /*
+     * 根据主表的当前内容重建所有副表，O(n log n)，每次都从头重建
+     * 返回false表示副表区的内存不足，此时副表处于失效状态
+     */
+    bool build();
+
+    /*
+     * 查询 x在[a,b] 且 y在[c,d] 的所有点，对每个点调用visit(const Point&)，点的访问顺序不保证有序
+     * 副表有效（is_built()为true）时O(log² n + k)，否则在主表上扫描x在[a,b]内的所有点
+     * 返回点的个数
+     */
+    template<typename Visitor>
+    uint32_t query(const X& a, const X& b, const Y& c, const Y& d, Visitor visit) const;
+
+    /*
+     * 副表是否和主表一致，为false时查询退化为扫描，需要调用build()
+     */
+    bool is_built() const { return header_->built; }
+
+    size_t base_mem_size(uint32_t max_len) const
+    {
+        size_t size = header_size();
+        size += Primary().max_mem_size(max_len);
+        size += dir_size(max_len);
+
+        return size;
+    }
+
+    size_t max_mem_size(uint32_t max_len) const
+    {
+        // 每个增强层上，副表的元素总数不超过max_len，副表个数也不超过max_len
+        size_t level_size = max_len * (Secondary().max_mem_size(1) + sec_header_size())
+            + Secondary().max_mem_size(max_len);
+
+        return base_mem_size(max_len) + AUG_LEVEL_NUM * level_size;
+    }
+
+    const std::string& err_msg() const { return err_msg_; }
+
+private:
+
+    static const int AUG_MIN_LEVEL = 2;         // 从这一层开始挂副表，跨度太小的层直接扫描更划算
+    static const uint32_t MAGIC_NUM = 0x534c3244;
+
+    // 主表按(x, y)排序，保证删除时能精确匹配到点
+    struct PointXLess
+    {
+        bool operator()(const Point& lhs, const Point& rhs) const
+        {
+            XCompare xcmp;
+            if(xcmp(lhs.x, rhs.x)) return true;
+            if(xcmp(rhs.x, lhs.x)) return false;
+
+            return YCompare()(lhs.y, rhs.y);
+        }
+    };
+
+    // 副表只读，按y排序即可
+    struct PointYLess
+    {
+        bool operator()(const Point& lhs, const Point& rhs) const
+        {
+            return YCompare()(lhs.y, rhs.y);
+        }
+    };
+
+    typedef SkipList<Point, PointXLess> Primary;
+    typedef SkipList<Point, PointYLess> Secondary;
+    typedef typename Primary::MemNode PrimaryNode;
+
+    // 挂副表的层数，AUG_MIN_LEVEL以上的层都挂，不管点集多大，查询拆出的完整跨度都是O(log n)段
+    static const int AUG_LEVEL_NUM = Primary::MAX_LEVEL_NUM - AUG_MIN_LEVEL;
+
+    struct SL2DHeader
+    {
+        uint32_t magic_num;
+        bool built;                     // 副表是否和主表一致
+        uint32_t max_len;
+        size_t mem_size;
+        size_t primary_size;            // 主表内存大小
+        size_t sec_alloc_size;          // 副表区已分配的大小，从副表区起始处算起
+    };
+
+    // 主表节点的目录项，在build()时填充
+    struct SL2DDirEntry
+    {
+        int level_num;                  // 节点的层数
+        size_t sec[AUG_LEVEL_NUM];      // 节点在各增强层上的副表偏移，为0表示没有
+    };
+
+    // 每个副表前面的头部
+    struct SL2DSecHeader
+    {
+        size_t mem_size;                // 副表的内存大小
+        uint32_t len;                   // 副表的长度
+    };
+
+    size_t header_size() const
+    {
+        return (sizeof(SL2DHeader) + 7) & (~7);
+    }
+
+    size_t sec_header_size() const
+    {
+        return (sizeof(SL2DSecHeader) + 7) & (~7);
+    }
+
+    size_t dir_size(uint32_t max_len) const
+    {
+        return (max_len + 1) * sizeof(SL2DDirEntry);
+    }
+
+    char* primary_mem() const { return reinterpret_cast<char*>(header_) + header_size(); }
+
+    SL2DDirEntry* dir() const
+    {
+        return reinterpret_cast<SL2DDirEntry*>(primary_mem() + header_->primary_size);
+    }
+
+    char* sec_area() const
+    {
+        return reinterpret_cast<char*>(dir()) + dir_size(header_->max_len);
+    }
+
+    PrimaryNode* node_of(size_t node_ref) const
+    {
+        return reinterpret_cast<PrimaryNode*>(primary_.deref(node_ref));
+    }
+
+    // 主表节点在目录中的槽位，主表节点在内存中是定长连续分配的
+    SL2DDirEntry& dir_entry(size_t node_ref) const
+    {
+        size_t slot = (node_ref - primary_.mem_header_->header_size) / primary_.mem_header_->node_size;
+        return dir()[slot];
+    }
+
+    // 在副表中查询y在[c,d]的点
+    template<typename Visitor>
+    uint32_t query_sec(size_t sec_off, const Y& c, const Y& d, Visitor& visit) const;
+
+private:
+    SL2DHeader* header_ = nullptr;
+    Primary primary_;
+    std::string err_msg_;
+};
+
+template<typename X, typename Y, typename XCompare, typename YCompare>
+bool SkipList2D<X, Y, XCompare, YCompare>::init(void* mem, size_t mem_size, uint32_t max_len, bool is_raw)
+{
+    if(!mem)
+    {
+        err_msg_ = "mem is nullptr";
+        return false;
+    }
+
+    if(mem_size < base_mem_size(max_len))
+    {
+        err_msg_ = "mem_size not enough";
+        return false;
+    }
+
+    header_ = reinterpret_cast<SL2DHeader*>(mem);
+    size_t primary_size = primary_.max_mem_size(max_len);
+    if(!is_raw)
+    {// 做一下简单的校验
+        if(header_->magic_num != MAGIC_NUM || header_->mem_size != mem_size
+            || header_->max_len != max_len || header_->primary_size != primary_size)
+        {
+            err_msg_ = "mem header check err";
+            return false;
+        }
+    }
+    else
+    {
+        memset(header_, 0, header_size());
+        header_->magic_num = MAGIC_NUM;
+        header_->built = true;
+        header_->max_len = max_len;
+        header_->mem_size = mem_size;
+        header_->primary_size = primary_size;
+        header_->sec_alloc_size = 0;
+    }
+
+    if(!primary_.init(primary_mem(), primary_size, max_len, is_raw))
+    {
+        err_msg_ = "primary init err: " + primary_.err_msg();
+        return false;
+    }
+
+    return true;
+}
+
+template<typename X, typename Y, typename XCompare, typename YCompare>
+bool SkipList2D<X, Y, XCompare, YCompare>::insert(const X& x, const Y& y)
+{
+    Point point;
+    point.x = x;
+    point.y = y;
+    if(!primary_.insert(point)) return false;
+
+    header_->built = false;
+    return true;
+}
+
+template<typename X, typename Y, typename XCompare, typename YCompare>
+uint32_t SkipList2D<X, Y, XCompare, YCompare>::erase(const X& x, const Y& y)
+{
+    Point point;
+    point.x = x;
+    point.y = y;
+    uint32_t count = primary_.erase(point);
+    if(count) header_->built = false;
+
+    return count;
+}
+
+template<typename X, typename Y, typename XCompare, typename YCompare>
+bool SkipList2D<X, Y, XCompare, YCompare>::build()
+{
+    header_->built = false;
+    header_->sec_alloc_size = 0;
+    memset(dir(), 0, dir_size(header_->max_len));
+
+    size_t sec_capacity = header_->mem_size - (sec_area() - reinterpret_cast<char*>(header_));
+    PrimaryNode* head = node_of(primary_.mem_header_->sl_info.head);
+    int level_num = primary_.mem_header_->sl_info.level_num;
+
+    // 每一层上出现的节点，层数至少是该层的层号加1，从低往高覆盖即得到节点层数
+    for(int i = 0; i < level_num; ++i)
+    {
+        for(size_t ref = head->sl_node_info.level[i].forward; ref; ref = node_of(ref)->sl_node_info.level[i].forward)
+            dir_entry(ref).level_num = i + 1;
+    }
+
+    for(int i = AUG_MIN_LEVEL; i < level_num; ++i)
+    {
+        for(size_t ref = head->sl_node_info.level[i].forward; ref; ref = node_of(ref)->sl_node_info.level[i].forward)
+        {
+            PrimaryNode* node = node_of(ref);
+            size_t end_ref = node->sl_node_info.level[i].forward;
+            uint32_t len = 0;
+            for(size_t r = ref; r != end_ref; r = node_of(r)->sl_node_info.level[0].forward)
+                ++len;
+
+            Secondary sec;
+            size_t sec_mem_size = sec.max_mem_size(len);
+            size_t need = sec_header_size() + sec_mem_size;
+            if(header_->sec_alloc_size + need > sec_capacity)
+            {
+                err_msg_ = "mem not enough for secondary lists";
+                return false;
+            }
+
+            char* sec_mem = sec_area() + header_->sec_alloc_size;
+            SL2DSecHeader* sec_header = reinterpret_cast<SL2DSecHeader*>(sec_mem);
+            sec_header->mem_size = sec_mem_size;
+            sec_header->len = len;
+            sec.init(sec_mem + sec_header_size(), sec_mem_size, len);
+            for(size_t r = ref; r != end_ref; r = node_of(r)->sl_node_info.level[0].forward)
+                sec.insert(node_of(r)->sl_node_info.element);
+
+            dir_entry(ref).sec[i - AUG_MIN_LEVEL] = sec_mem - reinterpret_cast<char*>(header_);
+            header_->sec_alloc_size += need;
+        }
+    }
+
+    header_->built = true;
+    return true;
+}
+
+template<typename X, typename Y, typename XCompare, typename YCompare>
+template<typename Visitor>
+uint32_t SkipList2D<X, Y, XCompare, YCompare>::query(const X& a, const X& b, const Y& c, const Y& d, Visitor visit) const
+{
+    XCompare xcmp;
+    YCompare ycmp;
+    if(xcmp(b, a) || ycmp(d, c)) return 0;
+
+    // 在主表上找到第一个x不小于a的节点
+    PrimaryNode* node = node_of(primary_.mem_header_->sl_info.head);
+    for(int i = primary_.mem_header_->sl_info.level_num - 1; i >= 0; --i)
+    {
+        while(node->sl_node_info.level[i].forward)
+        {
+            PrimaryNode* forward_node = node_of(node->sl_node_info.level[i].forward);
+            if(xcmp(forward_node->sl_node_info.element.x, a))
+                node = forward_node;
+            else
+                break;
+        }
+    }
+
+    uint32_t count = 0;
+    size_t ref = node->sl_node_info.level[0].forward;
+    if(!ref) return 0;
+
+    // 主表最后一个点的x不大于b时，到表尾的跨度也完整落在[a,b]内
+    PrimaryNode* tail = node_of(primary_.mem_header_->sl_info.tail);
+    bool tail_in = !xcmp(b, tail->sl_node_info.element.x);
+
+    while(ref)
+    {
+        node = node_of(ref);
+        if(xcmp(b, node->sl_node_info.element.x)) break;
+
+        if(header_->built)
+        {
+            // 找最高的一个增强层，其跨度完整落在[a,b]内
+            const SL2DDirEntry& entry = dir_entry(ref);
+            int i = entry.level_num - 1;
+            for(; i >= AUG_MIN_LEVEL; --i)
+            {
+                size_t forward = node->sl_node_info.level[i].forward;
+                if(forward ? !xcmp(b, node_of(forward)->sl_node_info.element.x) : tail_in)
+                    break;
+            }
+
+            if(i >= AUG_MIN_LEVEL)
+            {
+                count += query_sec(entry.sec[i - AUG_MIN_LEVEL], c, d, visit);
+                ref = node->sl_node_info.level[i].forward;
+                continue;
+            }
+        }
+
+        const Point& point = node->sl_node_info.element;
+        if(!ycmp(point.y, c) && !ycmp(d, point.y))
+        {
+            visit(point);
+            ++count;
+        }
+        ref = node->sl_node_info.level[0].forward;
+    }
+
+    return count;
+}
+
+template<typename X, typename Y, typename XCompare, typename YCompare>
+template<typename Visitor>
+uint32_t SkipList2D<X, Y, XCompare, YCompare>::query_sec(size_t sec_off, const Y& c, const Y& d, Visitor& visit) const
+{
+    char* sec_mem = reinterpret_cast<char*>(header_) + sec_off;
+    SL2DSecHeader* sec_header = reinterpret_cast<SL2DSecHeader*>(sec_mem);
+
+    Secondary sec;
+    sec.init(sec_mem + sec_header_size(), sec_header->mem_size, sec_header->len, false);
+
+    Point low = Point();
+    low.y = c;
+    uint32_t count = 0;
+    YCompare ycmp;
+    for(typename Secondary::Iterator it = sec.lower_bound(low); it != sec.end(); ++it)
+    {
+        if(ycmp(d, it->y)) break;
+
+        visit(*it);
+        ++count;
+    }
+
+    return count;
+}
+
+#endif
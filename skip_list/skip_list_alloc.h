@@ -0,0 +1,485 @@
+/*
+ * File        : skip_list_alloc.h
+ * Created Date: 2026-10-18 19:02:17
+ * Author      : philma
+ * Desc        : 跳跃表元素外部数据的区域内分配器，以及基于偏移指针、可以放在共享内存中的字符串和数组
+ *               SLArena放在跳跃表所在内存的尾部，按大小分级管理空闲块，小块按8字节精确分级，大块按2的幂分级
+ *               SLOffsetPtr保存目标相对自身的偏移，内存映射到不同地址的进程都能正确访问
+ *               SLString/SLVector构造时绑定当前线程的分配区（SLArenaScope指定），没有分配区时使用堆内存
+ *               SLStrView是不拥有内存的字符串视图，配合SLStringLess可以直接用网络缓冲区里的字节查找SLString
+ */
+
+#ifndef SKIP_LIST_ALLOC_H
+#define SKIP_LIST_ALLOC_H
+
+#include <new>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <type_traits>
+
+/*
+ * 偏移指针：保存目标地址相对自身地址的偏移，偏移为1表示空指针
+ */
+template<typename P>
+class SLOffsetPtr
+{
+public:
+    SLOffsetPtr(P* p = nullptr) { set(p); }
+
+    SLOffsetPtr(const SLOffsetPtr& rhs) { set(rhs.get()); }
+
+    SLOffsetPtr& operator=(const SLOffsetPtr& rhs)
+    {
+        set(rhs.get());
+        return *this;
+    }
+
+    SLOffsetPtr& operator=(P* p)
+    {
+        set(p);
+        return *this;
+    }
+
+    P* get() const
+    {
+        if(offset_ == 1) return nullptr;
+
+        return reinterpret_cast<P*>(const_cast<char*>(reinterpret_cast<const char*>(this)) + offset_);
+    }
+
+    P* operator->() const { return get(); }
+
+    P& operator*() const { return *get(); }
+
+    explicit operator bool() const { return offset_ != 1; }
+
+private:
+    void set(P* p)
+    {
+        offset_ = p ? reinterpret_cast<const char*>(p) - reinterpret_cast<const char*>(this) : 1;
+    }
+
+private:
+    ptrdiff_t offset_;
+};
+
+/*
+ * 区域内分配器，对象本身就放在被管理的内存开头，内部只保存相对自身的偏移
+ */
+class SLArena
+{
+    static const uint32_t MAGIC_NUM = 0x534C4152;
+    static const size_t SMALL_MAX = 256;                // 不超过这个大小的块按8字节精确分级
+    static const int SMALL_CLASS_NUM = SMALL_MAX / 8;
+    static const int CLASS_NUM = SMALL_CLASS_NUM + 24;  // 大块按2的幂分级，最大4G
+
+public:
+    /*
+     * 在mem上创建分配区，mem_size为整个分配区的大小，包括分配区头部；空间太小时返回nullptr
+     */
+    static SLArena* create(void* mem, size_t mem_size)
+    {
+        if(!mem || mem_size < header_size()) return nullptr;
+
+        SLArena* arena = reinterpret_cast<SLArena*>(mem);
+        memset(arena, 0, header_size());
+        arena->magic_num_ = MAGIC_NUM;
+        arena->mem_size_ = mem_size;
+        arena->alloc_size_ = header_size();
+        arena->used_size_ = 0;
+
+        return arena;
+    }
+
+    /*
+     * 挂接已经创建过的分配区，校验失败时返回nullptr
+     */
+    static SLArena* attach(void* mem, size_t mem_size)
+    {
+        SLArena* arena = reinterpret_cast<SLArena*>(mem);
+        if(!mem || arena->magic_num_ != MAGIC_NUM || arena->mem_size_ != mem_size) return nullptr;
+
+        return arena;
+    }
+
+    static size_t header_size()
+    {
+        return (sizeof(SLArena) + 7) & (~7);
+    }
+
+    /*
+     * 申请n字节，返回的地址8字节对齐；空间不足时返回nullptr
+     */
+    void* allocate(size_t n)
+    {
+        size_t block_size = 0;
+        int c = size_class(n, block_size);
+        if(c < 0) return nullptr;
+
+        size_t pos = 0;
+        if(free_list_[c])
+        {
+            pos = free_list_[c];
+            free_list_[c] = *reinterpret_cast<size_t*>(base() + pos);
+        }
+        else if(alloc_size_ + block_size <= mem_size_)
+        {
+            pos = alloc_size_;
+            alloc_size_ += block_size;
+        }
+        else
+            return nullptr;
+
+        used_size_ += block_size;
+
+        return base() + pos;
+    }
+
+    /*
+     * 释放allocate申请的内存，n须与申请时相同
+     */
+    void deallocate(void* p, size_t n)
+    {
+        size_t block_size = 0;
+        int c = size_class(n, block_size);
+        size_t pos = reinterpret_cast<char*>(p) - base();
+        *reinterpret_cast<size_t*>(p) = free_list_[c];
+        free_list_[c] = pos;
+        used_size_ -= block_size;
+    }
+
+    // 分配区总大小
+    size_t mem_size() const { return mem_size_; }
+
+    // 已切分出去的大小，包括头部和空闲块
+    size_t alloc_size() const { return alloc_size_; }
+
+    // 正在使用的块的总大小
+    size_t used_size() const { return used_size_; }
+
+    /*
+     * 当前线程的分配区，SLString/SLVector构造时绑定它
+     */
+    static SLArena*& current()
+    {
+        static thread_local SLArena* arena = nullptr;
+        return arena;
+    }
+
+private:
+    char* base() { return reinterpret_cast<char*>(this); }
+
+    // 返回大小分级，block_size为该级的块大小；超出最大分级时返回-1
+    static int size_class(size_t n, size_t& block_size)
+    {
+        if(n <= SMALL_MAX)
+        {
+            int c = n ? static_cast<int>((n - 1) / 8) : 0;
+            block_size = (c + 1) * 8;
+            return c;
+        }
+
+        int shift = 9;
+        while((static_cast<size_t>(1) << shift) < n)
+            ++shift;
+
+        if(shift - 9 >= CLASS_NUM - SMALL_CLASS_NUM) return -1;
+
+        block_size = static_cast<size_t>(1) << shift;
+        return SMALL_CLASS_NUM + shift - 9;
+    }
+
+private:
+    uint32_t magic_num_;
+    size_t mem_size_;                   // 分配区总大小
+    size_t alloc_size_;                 // 已切分出去的大小
+    size_t used_size_;                  // 正在使用的块的总大小
+    size_t free_list_[CLASS_NUM];       // 各级空闲块列表，保存相对分配区开头的偏移，为0表示列表为空
+};
+
+/*
+ * 在作用域内指定当前线程的分配区，离开作用域时恢复
+ */
+class SLArenaScope
+{
+public:
+    explicit SLArenaScope(SLArena* arena)
+        :prev_(SLArena::current())
+    {
+        SLArena::current() = arena;
+    }
+
+    ~SLArenaScope() { SLArena::current() = prev_; }
+
+private:
+    SLArenaScope(const SLArenaScope&);
+    SLArenaScope& operator=(const SLArenaScope&);
+
+private:
+    SLArena* prev_;
+};
+
+// 绑定了分配区时从分配区申请，否则从堆申请（表外的临时对象，或HeapSkipList这类不跨进程的表）；都失败时抛出std::bad_alloc
+inline void* sl_allocate(SLArena* arena, size_t n)
+{
+    void* p = arena ? arena->allocate(n) : malloc(n);
+    if(!p) throw std::bad_alloc();
+
+    return p;
+}
+
+inline void sl_deallocate(SLArena* arena, void* p, size_t n)
+{
+    if(arena) arena->deallocate(p, n);
+    else free(p);
+}
+
+/*
+ * 可以放在共享内存中的字符串，内容以'\0'结尾
+ */
+class SLString
+{
+public:
+    SLString()
+        :data_(nullptr), arena_(SLArena::current()), size_(0), capacity_(0)
+    {}
+
+    SLString(const char* s)
+        :data_(nullptr), arena_(SLArena::current()), size_(0), capacity_(0)
+    {
+        assign(s, strlen(s));
+    }
+
+    SLString(const char* s, size_t n)
+        :data_(nullptr), arena_(SLArena::current()), size_(0), capacity_(0)
+    {
+        assign(s, n);
+    }
+
+    SLString(const std::string& s)
+        :data_(nullptr), arena_(SLArena::current()), size_(0), capacity_(0)
+    {
+        assign(s.data(), s.size());
+    }
+
+    SLString(const SLString& rhs)
+        :data_(nullptr), arena_(SLArena::current()), size_(0), capacity_(0)
+    {
+        assign(rhs.data(), rhs.size());
+    }
+
+    SLString& operator=(const SLString& rhs)
+    {
+        if(this != &rhs) assign(rhs.data(), rhs.size());
+        return *this;
+    }
+
+    ~SLString()
+    {
+        if(data_) sl_deallocate(arena_.get(), data_.get(), capacity_);
+    }
+
+    /*
+     * 替换内容，容量不够时重新申请，申请仍在构造时绑定的分配区上进行
+     */
+    void assign(const char* s, size_t n)
+    {
+        if(n + 1 > capacity_)
+        {
+            char* data = static_cast<char*>(sl_allocate(arena_.get(), n + 1));
+            if(data_) sl_deallocate(arena_.get(), data_.get(), capacity_);
+            data_ = data;
+            capacity_ = static_cast<uint32_t>(n + 1);
+        }
+
+        memcpy(data_.get(), s, n);
+        data_.get()[n] = '\0';
+        size_ = static_cast<uint32_t>(n);
+    }
+
+    const char* data() const { return data_ ? data_.get() : ""; }
+
+    const char* c_str() const { return data(); }
+
+    size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    std::string str() const { return std::string(data(), size_); }
+
+    int compare(const char* s, size_t n) const
+    {
+        int ret = memcmp(data(), s, size_ < n ? size_ : n);
+        if(ret) return ret;
+
+        return size_ < n ? -1 : (size_ > n ? 1 : 0);
+    }
+
+    int compare(const SLString& rhs) const { return compare(rhs.data(), rhs.size()); }
+
+    friend bool operator<(const SLString& lhs, const SLString& rhs) { return lhs.compare(rhs) < 0; }
+    friend bool operator==(const SLString& lhs, const SLString& rhs) { return lhs.compare(rhs) == 0; }
+    friend bool operator!=(const SLString& lhs, const SLString& rhs) { return lhs.compare(rhs) != 0; }
+
+private:
+    SLOffsetPtr<char> data_;
+    SLOffsetPtr<SLArena> arena_;        // 构造时绑定的分配区，为空表示使用堆内存
+    uint32_t size_;
+    uint32_t capacity_;                 // 申请的内存大小，包括结尾的'\0'
+};
+
+/*
+ * 字符串视图，只记录地址和长度，不拷贝内容
+ */
+class SLStrView
+{
+public:
+    SLStrView(const char* s, size_t n) :data_(s), size_(n) {}
+
+    SLStrView(const char* s) :data_(s), size_(strlen(s)) {}
+
+    SLStrView(const std::string& s) :data_(s.data()), size_(s.size()) {}
+
+    SLStrView(const SLString& s) :data_(s.data()), size_(s.size()) {}
+
+    const char* data() const { return data_; }
+
+    size_t size() const { return size_; }
+
+    int compare(const SLStrView& rhs) const
+    {
+        int ret = memcmp(data_, rhs.data_, size_ < rhs.size_ ? size_ : rhs.size_);
+        if(ret) return ret;
+
+        return size_ < rhs.size_ ? -1 : (size_ > rhs.size_ ? 1 : 0);
+    }
+
+private:
+    const char* data_;
+    size_t size_;
+};
+
+/*
+ * 字符串的透明比较，SLString、SLStrView、std::string、const char*之间可以互相比较
+ * 用作SkipList<SLString, SLStringLess>的Compare时，find/get_index/lower_bound可以直接传入SLStrView
+ */
+struct SLStringLess
+{
+    typedef void is_transparent;
+
+    template<typename A, typename B>
+    bool operator()(const A& lhs, const B& rhs) const
+    {
+        return SLStrView(lhs).compare(SLStrView(rhs)) < 0;
+    }
+};
+
+/*
+ * 可以放在共享内存中的数组，元素须能按字节拷贝
+ */
+template<typename V>
+class SLVector
+{
+    static_assert(std::is_trivially_copyable<V>::value, "SLVector element must be trivially copyable");
+
+public:
+    SLVector()
+        :data_(nullptr), arena_(SLArena::current()), size_(0), capacity_(0)
+    {}
+
+    SLVector(const V* first, size_t n)
+        :data_(nullptr), arena_(SLArena::current()), size_(0), capacity_(0)
+    {
+        assign(first, n);
+    }
+
+    SLVector(const SLVector& rhs)
+        :data_(nullptr), arena_(SLArena::current()), size_(0), capacity_(0)
+    {
+        assign(rhs.data(), rhs.size());
+    }
+
+    SLVector& operator=(const SLVector& rhs)
+    {
+        if(this != &rhs) assign(rhs.data(), rhs.size());
+        return *this;
+    }
+
+    ~SLVector()
+    {
+        if(data_) sl_deallocate(arena_.get(), data_.get(), capacity_ * sizeof(V));
+    }
+
+    void assign(const V* first, size_t n)
+    {
+        size_ = 0;
+        reserve(n);
+        if(n) memcpy(data_.get(), first, n * sizeof(V));
+        size_ = static_cast<uint32_t>(n);
+    }
+
+    void reserve(size_t n)
+    {
+        if(n <= capacity_) return;
+
+        V* data = static_cast<V*>(sl_allocate(arena_.get(), n * sizeof(V)));
+        if(size_) memcpy(data, data_.get(), size_ * sizeof(V));
+        if(data_) sl_deallocate(arena_.get(), data_.get(), capacity_ * sizeof(V));
+        data_ = data;
+        capacity_ = static_cast<uint32_t>(n);
+    }
+
+    void push_back(const V& v)
+    {
+        if(size_ == capacity_) reserve(capacity_ ? capacity_ * 2 : 4);
+        data_.get()[size_++] = v;
+    }
+
+    void pop_back() { --size_; }
+
+    void clear() { size_ = 0; }
+
+    V& operator[](size_t i) { return data_.get()[i]; }
+
+    const V& operator[](size_t i) const { return data_.get()[i]; }
+
+    V* data() { return data_.get(); }
+
+    const V* data() const { return data_.get(); }
+
+    V* begin() { return data_.get(); }
+
+    V* end() { return data_.get() + size_; }
+
+    const V* begin() const { return data_.get(); }
+
+    const V* end() const { return data_.get() + size_; }
+
+    size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    // 按字典序比较，用作跳跃表元素的排序
+    friend bool operator<(const SLVector& lhs, const SLVector& rhs)
+    {
+        size_t n = lhs.size_ < rhs.size_ ? lhs.size_ : rhs.size_;
+        for(size_t i = 0; i < n; ++i)
+        {
+            if(lhs[i] < rhs[i]) return true;
+            if(rhs[i] < lhs[i]) return false;
+        }
+
+        return lhs.size_ < rhs.size_;
+    }
+
+private:
+    SLOffsetPtr<V> data_;
+    SLOffsetPtr<SLArena> arena_;        // 构造时绑定的分配区，为空表示使用堆内存
+    uint32_t size_;
+    uint32_t capacity_;
+};
+
+#endif
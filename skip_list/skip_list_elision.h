@@ -0,0 +1,439 @@
+/*
+ * File        : skip_list_elision.h
+ * Created Date: 2026-10-18 19:47:52
+ * Author      : philma
+ * Desc        : 锁消除(lock elision)模式的跳跃表，实验性质，可以放在共享内存中供多个线程/进程同时使用
+ *               所有操作名义上都在一把全局自旋锁保护下，CPU支持RTM时先尝试以硬件事务执行临界区，
+ *               事务里只读取锁字，不真正加锁，访问不同部分的操作可以并行；事务中止若干次后才真正加锁
+ *               连续中止时，接下来的若干次临界区直接加锁，次数随连续失败翻倍，事务成功后恢复
+ *               不支持RTM的CPU（以及非x86平台）上始终加锁执行
+ *               为了让改动表中不同位置的写操作也能并行，每次操作都要改的计数不放在事务的写集合里：
+ *               长度和版本号的增减记在线程所在的计数槽上（各占一个缓存行），加锁执行时并入表头；
+ *               节点从计数槽上的私有空闲链表取还，链表空了才加锁从表头批量申请；新节点的层数在临界区外
+ *               用线程私有的随机数取好，不调用random()（glibc的random()要加锁并改全局状态，所有插入都会冲突）
+ *               Traits::HAS_SPAN为true时，插入删除还要改高层前驱（通常是头节点）的跨度，写操作之间仍然冲突；
+ *               需要并行写时用HAS_SPAN为false的Traits，此时不支持get_index
+ *               HAS_SPAN为false时仍有几处共享的写，碰上时照样冲突：插入到表尾时改sl_info.tail，
+ *               新节点层数超过当前层数、或删除使最高层变空时改sl_info.level_num，同一计数槽上的线程改同一个槽
+ */
+
+#ifndef SKIP_LIST_ELISION_H
+#define SKIP_LIST_ELISION_H
+
+#include "skip_list.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#include <cpuid.h>
+#define SL_ELISION_RTM 1
+#endif
+
+#ifdef SL_ELISION_RTM
+
+__attribute__((target("rtm"))) inline unsigned sl_xbegin() { return _xbegin(); }
+
+__attribute__((target("rtm"))) inline void sl_xend() { _xend(); }
+
+// 事务中发现锁已被占用时中止，中止码0xff
+__attribute__((target("rtm"))) inline void sl_xabort_locked() { _xabort(0xff); }
+
+inline bool sl_cpu_has_rtm()
+{
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if(!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+
+    return (ebx & (1u << 11)) != 0;
+}
+
+inline void sl_cpu_relax() { __builtin_ia32_pause(); }
+
+#else
+
+inline bool sl_cpu_has_rtm() { return false; }
+
+inline void sl_cpu_relax() {}
+
+#endif
+
+template<typename T, typename Compare = std::less<T>, typename Traits = SLDefaultTraits>
+class ElidedSkipList
+{
+    typedef SkipList<T, Compare, Traits> List;
+
+public:
+    static const int MAX_RETRY = 3;             // 一次临界区最多尝试的事务次数
+    static const uint32_t MIN_SKIP = 4;         // 事务失败后直接加锁的临界区次数，连续失败时翻倍
+    static const uint32_t MAX_SKIP = 4096;
+    static const int COUNTER_NUM = 32;          // 计数槽个数，线程按序号散列到槽上，同槽的线程之间会冲突
+    static const uint32_t STASH_MAX = 32;       // 每个计数槽私有空闲链表的最大节点数，超出的还给表头
+    static const uint32_t STASH_REFILL = 16;    // 私有空闲链表空了时，一次从表头申请的节点数
+
+    // 当前线程的执行统计
+    struct Stats
+    {
+        uint64_t commit;                // 以事务方式完成的临界区数
+        uint64_t abort;                 // 事务中止次数
+        uint64_t fallback;              // 加锁执行的临界区数
+    };
+
+    /*
+     * 初始化，is_raw为false时表示挂接到已经初始化过的内存上
+     */
+    bool init(void* mem, size_t mem_size, uint32_t max_sl_len, bool is_raw = true);
+
+    /*
+     * 根据跳跃表的最大长度，获取需要的最大内存大小
+     */
+    size_t max_mem_size(uint32_t max_sl_len) const { return header_size() + list_.max_mem_size(list_len(max_sl_len)); }
+
+    /*
+     * 开启或关闭锁消除，关闭后始终加锁执行，用于对比；CPU不支持RTM时开启无效
+     */
+    void set_elision(bool enable) { elision_ = enable && rtm_; }
+
+    bool rtm_supported() const { return rtm_; }
+
+    /*
+     * 插入一个元素，返回false表示插入失败，仅在空间不足的情况下发生
+     */
+    bool insert(const T& element);
+
+    /*
+     * 删除元素，如果有多个相同元素，则均删除，每个元素的删除是一个单独的临界区
+     * 返回删除的元素个数
+     */
+    uint32_t erase(const T& element);
+
+    /*
+     * 查找元素的位置索引，同SkipList::get_index
+     */
+    uint32_t get_index(const T& element)
+    {
+        return critical([&]() { return list_.get_index(element); });
+    }
+
+    /*
+     * 查找元素，找到时拷贝到out中
+     */
+    bool find(const T& element, T& out)
+    {
+        return critical([&]() {
+            typename List::Iterator it = list_.find(element);
+            if(it == list_.end()) return false;
+
+            out = *it;
+            return true;
+        });
+    }
+
+    /*
+     * 表中元素个数，表头的长度加上各计数槽上还没并入的增减，有并发修改时只是一个近似值
+     */
+    uint32_t length() const;
+
+    static Stats& thread_stats()
+    {
+        static thread_local Stats stats = {0, 0, 0};
+        return stats;
+    }
+
+    const std::string& err_msg() const { return err_msg_; }
+
+private:
+
+    static const uint32_t MAGIC_NUM = 0x454C5344;
+
+    typedef typename List::MemNode MemNode;
+
+    // 计数槽，只在临界区内读写，各占一个缓存行
+    struct ElisionCounter
+    {
+        int64_t length;                 // 还没并入表头的长度增减
+        uint64_t version;               // 还没并入表头的修改次数
+        size_t free_list;               // 私有空闲链表，通过节点的next串起来
+        uint32_t free_num;              // 私有空闲链表的节点数
+        char pad[36];
+    };
+
+    // 锁字和自适应计数各占一个缓存行，计数的改动不会中止读取锁字的事务
+    struct ElisionHeader
+    {
+        uint32_t magic_num;
+        char pad0[60];
+        uint32_t lock;                  // 全局自旋锁，0表示空闲
+        char pad1[60];
+        uint32_t skip;                  // 接下来直接加锁的临界区次数，多线程下是近似值
+        uint32_t skip_len;              // 下一次事务失败后设置的skip
+        char pad2[56];
+        ElisionCounter counters[COUNTER_NUM];
+    };
+
+    static size_t header_size() { return (sizeof(ElisionHeader) + 63) & (~63); }
+
+    // 各计数槽的私有空闲链表占着的节点也要算在表的容量里
+    static uint32_t list_len(uint32_t max_sl_len) { return max_sl_len + COUNTER_NUM * STASH_MAX; }
+
+    // 当前线程的计数槽，线程第一次使用时按进程号和进程内序号散列
+    ElisionCounter& counter() const
+    {
+        static std::atomic<uint32_t> thread_seq(0);
+        static thread_local uint32_t slot = (static_cast<uint32_t>(getpid()) * 2654435761u + thread_seq.fetch_add(1)) % COUNTER_NUM;
+        return header_->counters[slot];
+    }
+
+    // 把计数槽上的增减并入表头，须在加锁时调用
+    void fold(ElisionCounter& c)
+    {
+        list_.mem_header_->sl_info.length = static_cast<uint32_t>(list_.mem_header_->sl_info.length + c.length);
+        list_.mem_header_->version += c.version;
+        c.length = 0;
+        c.version = 0;
+    }
+
+    // 加锁从表头申请一批节点放到计数槽的私有空闲链表上，返回false表示一个也没申请到
+    bool refill(ElisionCounter& c);
+
+    // 线程私有的xorshift，不像random()那样写共享状态
+    static uint32_t thread_random()
+    {
+        static thread_local uint32_t seed = 0;
+        if(!seed) seed = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&seed)) | 1;
+
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    }
+
+    // 同SkipList::random_level，在临界区外调用
+    static int random_level()
+    {
+        int level = 1;
+        while((thread_random() & 0xFFFF) < (1.0 / List::SKIPLIST_P * 0xFFFF))
+            level += 1;
+
+        return (level < List::MAX_LEVEL_NUM ? level : List::MAX_LEVEL_NUM);
+    }
+
+    void lock()
+    {
+        for(;;)
+        {
+            if(!__atomic_exchange_n(&header_->lock, 1, __ATOMIC_ACQUIRE)) return;
+
+            while(__atomic_load_n(&header_->lock, __ATOMIC_RELAXED))
+                sl_cpu_relax();
+        }
+    }
+
+    void unlock() { __atomic_store_n(&header_->lock, 0, __ATOMIC_RELEASE); }
+
+    // 执行一个临界区，先尝试事务，失败后加锁
+    template<typename F>
+    auto critical(F f) -> decltype(f());
+
+private:
+    ElisionHeader* header_ = nullptr;
+    List list_;
+    bool rtm_ = false;
+    bool elision_ = false;
+    std::string err_msg_;
+};
+
+template<typename T, typename Compare, typename Traits>
+bool ElidedSkipList<T, Compare, Traits>::init(void* mem, size_t mem_size, uint32_t max_sl_len, bool is_raw)
+{
+    if(!mem)
+    {
+        err_msg_ = "mem is nullptr";
+        return false;
+    }
+
+    if(mem_size < max_mem_size(max_sl_len))
+    {
+        err_msg_ = "mem_size not enough";
+        return false;
+    }
+
+    header_ = reinterpret_cast<ElisionHeader*>(mem);
+    if(!is_raw)
+    {
+        if(header_->magic_num != MAGIC_NUM)
+        {
+            err_msg_ = "elision header check err";
+            return false;
+        }
+    }
+    else
+    {
+        memset(header_, 0, header_size());
+        header_->magic_num = MAGIC_NUM;
+        header_->skip_len = MIN_SKIP;
+    }
+
+    if(!list_.init(reinterpret_cast<char*>(mem) + header_size(), mem_size - header_size(), list_len(max_sl_len), is_raw))
+    {
+        err_msg_ = list_.err_msg();
+        return false;
+    }
+
+    rtm_ = sl_cpu_has_rtm();
+    elision_ = rtm_;
+
+    return true;
+}
+
+template<typename T, typename Compare, typename Traits>
+bool ElidedSkipList<T, Compare, Traits>::insert(const T& element)
+{
+    ElisionCounter& c = counter();
+    // 私有空闲链表空了先补充，补充不到（表满或者被同槽的线程取走）时临界区内再从表头申请
+    if(!__atomic_load_n(&c.free_list, __ATOMIC_RELAXED)) refill(c);
+    int level = random_level();
+
+    return critical([&]() {
+        size_t node_ref = c.free_list;
+        if(node_ref)
+        {
+            c.free_list = reinterpret_cast<MemNode*>(list_.deref(node_ref))->next;
+            c.free_num -= 1;
+            list_.reset_node(node_ref);
+        }
+        else if(!(node_ref = list_.alloc_node()))
+            return false;
+
+        MemNode* node = reinterpret_cast<MemNode*>(list_.deref(node_ref));
+        new(&node->sl_node_info.element) T(element);
+        list_.link_node(node_ref, false, level);
+        c.length += 1;
+        c.version += 1;
+
+        return true;
+    });
+}
+
+template<typename T, typename Compare, typename Traits>
+uint32_t ElidedSkipList<T, Compare, Traits>::erase(const T& element)
+{
+    ElisionCounter& c = counter();
+    uint32_t count = 0;
+    while(critical([&]() {
+        size_t node_ref = 0;
+        if(!list_.del_first_of(element, &node_ref)) return false;
+
+        MemNode* node = reinterpret_cast<MemNode*>(list_.deref(node_ref));
+        node->sl_node_info.element.~T();
+        if(c.free_num < STASH_MAX)
+        {
+            node->next = c.free_list;
+            c.free_list = node_ref;
+            c.free_num += 1;
+        }
+        else
+            list_.release_node(node_ref);
+
+        c.length -= 1;
+        c.version += 1;
+
+        return true;
+    }))
+        ++count;
+
+    return count;
+}
+
+template<typename T, typename Compare, typename Traits>
+uint32_t ElidedSkipList<T, Compare, Traits>::length() const
+{
+    int64_t length = __atomic_load_n(&list_.mem_header_->sl_info.length, __ATOMIC_RELAXED);
+    for(int i = 0; i < COUNTER_NUM; ++i)
+        length += __atomic_load_n(&header_->counters[i].length, __ATOMIC_RELAXED);
+
+    return length > 0 ? static_cast<uint32_t>(length) : 0;
+}
+
+template<typename T, typename Compare, typename Traits>
+bool ElidedSkipList<T, Compare, Traits>::refill(ElisionCounter& c)
+{
+    lock();
+    for(uint32_t i = c.free_num; i < STASH_REFILL; ++i)
+    {
+        size_t node_ref = list_.alloc_node();
+        if(!node_ref) break;
+
+        reinterpret_cast<MemNode*>(list_.deref(node_ref))->next = c.free_list;
+        c.free_list = node_ref;
+        c.free_num += 1;
+    }
+    fold(c);
+    bool ok = c.free_list != 0;
+    unlock();
+
+    return ok;
+}
+
+template<typename T, typename Compare, typename Traits>
+template<typename F>
+auto ElidedSkipList<T, Compare, Traits>::critical(F f) -> decltype(f())
+{
+    Stats& stats = thread_stats();
+#ifdef SL_ELISION_RTM
+    if(elision_)
+    {
+        // 多个线程同时递减时用CAS，不会把skip减成负数（回绕成很大的数）
+        uint32_t skip = __atomic_load_n(&header_->skip, __ATOMIC_RELAXED);
+        while(skip && !__atomic_compare_exchange_n(&header_->skip, &skip, skip - 1,
+            true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+        }
+
+        if(!skip)
+        {
+            for(int retry = 0; retry < MAX_RETRY; ++retry)
+            {
+                // 等锁空闲再开始事务，否则事务一开始就会因为锁被占用而中止
+                while(__atomic_load_n(&header_->lock, __ATOMIC_RELAXED))
+                    sl_cpu_relax();
+
+                unsigned status = sl_xbegin();
+                if(status == _XBEGIN_STARTED)
+                {
+                    // 读取锁字，使加锁执行的线程写锁字时中止本事务
+                    if(__atomic_load_n(&header_->lock, __ATOMIC_RELAXED)) sl_xabort_locked();
+
+                    decltype(f()) ret = f();
+                    sl_xend();
+
+                    ++stats.commit;
+                    if(__atomic_load_n(&header_->skip_len, __ATOMIC_RELAXED) != MIN_SKIP)
+                        __atomic_store_n(&header_->skip_len, MIN_SKIP, __ATOMIC_RELAXED);
+
+                    return ret;
+                }
+
+                ++stats.abort;
+                // 硬件提示重试也不会成功的（如容量超限、系统调用），直接加锁
+                if(!(status & _XABORT_RETRY) && !(status & _XABORT_EXPLICIT)) break;
+            }
+
+            // 同时失败的线程各自把skip_len翻倍一次，不会丢失翻倍
+            uint32_t skip_len = __atomic_load_n(&header_->skip_len, __ATOMIC_RELAXED);
+            while(!__atomic_compare_exchange_n(&header_->skip_len, &skip_len, skip_len < MAX_SKIP ? skip_len * 2 : MAX_SKIP,
+                true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+            }
+            __atomic_store_n(&header_->skip, skip_len, __ATOMIC_RELAXED);
+        }
+    }
+#endif
+
+    lock();
+    decltype(f()) ret = f();
+    fold(counter());
+    unlock();
+    ++stats.fallback;
+
+    return ret;
+}
+
+#endif
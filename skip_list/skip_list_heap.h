@@ -0,0 +1,129 @@
+/*
+ * File        : skip_list_heap.h
+ * Created Date: 2026-10-19 03:18:44
+ * Author      : philma
+ * Desc        : 自己管理内存的跳跃表，用作普通的进程内容器，不用再计算max_mem_size、准备内存和调用init
+ *               基于分段模式（Traits::SEGMENTED）：构造时按初始容量映射第一块内存，用完后按块增长，
+ *               每块是匿名映射并建议内核使用透明大页(MADV_HUGEPAGE)，块大小从第一块开始翻倍，最大MAX_CHUNK_SIZE
+ *               节点仍然在块内按偏移连续分配、用空闲链表复用，块只增不减，析构时析构所有元素并释放所有块
+ *               没有分配区，元素的外部数据（如SLString）在进程堆上申请
+ *               接口同SkipList；构造失败（映射内存失败）时err_msg非空，不能使用
+ */
+
+#ifndef SKIP_LIST_HEAP_H
+#define SKIP_LIST_HEAP_H
+
+#include "skip_list.h"
+
+struct SLHeapTraits : SLDefaultTraits
+{
+    static const bool SEGMENTED = true;
+};
+
+template<typename T, typename Compare = std::less<T>, typename Traits = SLHeapTraits>
+class HeapSkipList : public SkipList<T, Compare, Traits>
+{
+    static_assert(Traits::SEGMENTED, "HeapSkipList requires Traits::SEGMENTED");
+
+    typedef SkipList<T, Compare, Traits> Base;
+
+public:
+    static const size_t HUGE_PAGE_SIZE = 2 << 20;
+    static const size_t MAX_CHUNK_SIZE = static_cast<size_t>(1) << 30;
+
+    /*
+     * init_len为第一块内存能放下的元素个数，之后按需增长
+     */
+    explicit HeapSkipList(uint32_t init_len = 1024);
+
+    ~HeapSkipList();
+
+    HeapSkipList(const HeapSkipList&) = delete;
+    HeapSkipList& operator=(const HeapSkipList&) = delete;
+
+    /*
+     * 已映射的内存总大小
+     */
+    size_t capacity_bytes() const
+    {
+        size_t size = 0;
+        for(size_t i = 0; i < chunks_.size(); ++i)
+            size += chunks_[i].second;
+
+        return size;
+    }
+
+private:
+
+    // 映射一块按大页对齐的内存，大小按大页取整
+    void* map_chunk(size_t& size);
+
+private:
+    std::vector<std::pair<void*, size_t>> chunks_;
+};
+
+template<typename T, typename Compare, typename Traits>
+HeapSkipList<T, Compare, Traits>::HeapSkipList(uint32_t init_len)
+{
+    size_t size = Base::max_mem_size(init_len);
+    void* mem = map_chunk(size);
+    if(!mem) return;
+
+    // 新块从第一块的大小开始翻倍，每次申请新块后把下一块的大小写回内存头
+    this->set_segment_provider([this](uint32_t, size_t segment_size, bool create) -> void* {
+        if(!create) return nullptr;
+
+        size_t size = segment_size;
+        void* chunk = map_chunk(size);
+        if(chunk && segment_size < MAX_CHUNK_SIZE)
+            this->mem_header_->segment_size = segment_size * 2;
+
+        return chunk;
+    }, size);
+
+    // 表只在本进程中使用，元素的外部数据（如SLString）直接放在堆上
+    this->heap_elements_ = true;
+
+    // 分段模式下init的内存用完后才会申请新块，max_sl_len只用于校验第一块的大小
+    Base::init(mem, size, init_len);
+}
+
+template<typename T, typename Compare, typename Traits>
+HeapSkipList<T, Compare, Traits>::~HeapSkipList()
+{
+    if(this->mem_header_ && !std::is_trivially_destructible<T>::value) this->clear();
+
+    for(size_t i = 0; i < chunks_.size(); ++i)
+        munmap(chunks_[i].first, chunks_[i].second);
+}
+
+template<typename T, typename Compare, typename Traits>
+void* HeapSkipList<T, Compare, Traits>::map_chunk(size_t& size)
+{
+    size = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+
+    // 多映射一个大页，再把首尾不对齐的部分还回去
+    void* raw = mmap(nullptr, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(raw == MAP_FAILED)
+    {
+        this->err_msg_ = "mmap chunk failed";
+        return nullptr;
+    }
+
+    uintptr_t begin = reinterpret_cast<uintptr_t>(raw);
+    uintptr_t aligned = (begin + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    if(aligned > begin) munmap(raw, aligned - begin);
+    if(aligned + size < begin + size + HUGE_PAGE_SIZE)
+        munmap(reinterpret_cast<void*>(aligned + size), begin + HUGE_PAGE_SIZE - aligned);
+
+    void* mem = reinterpret_cast<void*>(aligned);
+
+#ifdef MADV_HUGEPAGE
+    madvise(mem, size, MADV_HUGEPAGE);
+#endif
+    chunks_.push_back(std::make_pair(mem, size));
+
+    return mem;
+}
+
+#endif
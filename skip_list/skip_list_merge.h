@@ -0,0 +1,261 @@
+/*
+ * File        : skip_list_merge.h
+ * Created Date: 2026-10-18 14:21:09
+ * Author      : philma
+ * Desc        : 多个有序跳跃表的k路归并视图，不物化归并结果
+ *               全局顺序按(元素, 表序号)排列，相同元素排在序号小的表前面，同一个表内保持原有顺序
+ *               按全局排名定位时，每轮在各表的候选区间中点里取加权中位数作为枢轴，用find(index)取元素、
+ *               用get_lower_index/get_upper_index算出枢轴的全局排名，每轮至少排除四分之一的候选元素，
+ *               共O(log(kn))轮，每轮O(k log n)，即O(k log² n)
+ */
+
+#ifndef SKIP_LIST_MERGE_H
+#define SKIP_LIST_MERGE_H
+
+#include <vector>
+#include <algorithm>
+#include "skip_list.h"
+
+template<typename T, typename Compare = std::less<T>, typename Traits = SLDefaultTraits>
+class SkipListMerger
+{
+    static_assert(Traits::HAS_SPAN, "SkipListMerger requires Traits::HAS_SPAN");
+
+public:
+    typedef SkipList<T, Compare, Traits> List;
+    typedef typename List::Iterator ListIterator;
+
+    SkipListMerger(const List* const* lists, int list_num)
+        :lists_(lists, lists + list_num)
+    {}
+
+    explicit SkipListMerger(const std::vector<const List*>& lists)
+        :lists_(lists)
+    {}
+
+    /*
+     * 所有表的元素总数
+     */
+    uint64_t length() const
+    {
+        uint64_t len = 0;
+        for(size_t i = 0; i < lists_.size(); ++i)
+            len += lists_[i]->length();
+
+        return len;
+    }
+
+    /*
+     * 根据全局排名定位元素，排名从1开始，返回元素所在的表序号和表内位置索引
+     * 排名不在[1, length]范围内时返回false
+     */
+    bool select(uint64_t rank, int& list_id, uint32_t& index) const;
+
+    /*
+     * 计算元素的全局排名：所有表中小于element的元素个数加1
+     */
+    uint64_t get_lower_index(const T& element) const
+    {
+        uint64_t index = 1;
+        for(size_t i = 0; i < lists_.size(); ++i)
+            index += lists_[i]->get_lower_index(element) - 1;
+
+        return index;
+    }
+
+    class Iterator;
+
+    /*
+     * 返回从全局排名rank开始的归并迭代器，排名超出范围时迭代器直接结束
+     */
+    Iterator seek(uint64_t rank) const;
+
+    Iterator begin() const { return seek(1); }
+
+    /*
+     * 按全局顺序遍历的迭代器，内部对各表的当前位置维护一个小顶堆
+     */
+    class Iterator
+    {
+    public:
+        bool valid() const { return !heap_.empty(); }
+
+        const T& operator*() const { return *cursors_[heap_.front()]; }
+
+        const T* operator->() const { return &(*cursors_[heap_.front()]); }
+
+        // 当前元素所在的表序号
+        int list_id() const { return heap_.front(); }
+
+        Iterator& operator++()
+        {
+            std::pop_heap(heap_.begin(), heap_.end(), Greater(cursors_));
+            int id = heap_.back();
+            heap_.pop_back();
+            if(++cursors_[id] != merger_->lists_[id]->end())
+            {
+                heap_.push_back(id);
+                std::push_heap(heap_.begin(), heap_.end(), Greater(cursors_));
+            }
+
+            return *this;
+        }
+
+    private:
+        friend class SkipListMerger;
+
+        // 堆比较：全局顺序靠后的在下面
+        struct Greater
+        {
+            explicit Greater(const std::vector<ListIterator>& cursors_)
+                :cursors(cursors_)
+            {}
+
+            bool operator()(int lhs, int rhs) const
+            {
+                Compare cmp;
+                const T& l = *cursors[lhs];
+                const T& r = *cursors[rhs];
+                if(cmp(r, l)) return true;
+                if(cmp(l, r)) return false;
+
+                return lhs > rhs;
+            }
+
+            const std::vector<ListIterator>& cursors;
+        };
+
+        explicit Iterator(const SkipListMerger* merger)
+            :merger_(merger)
+        {}
+
+    private:
+        const SkipListMerger* merger_;
+        std::vector<ListIterator> cursors_;
+        std::vector<int> heap_;
+    };
+
+private:
+
+    // 全局顺序中排在(element, list_id)之前的，list表中的元素个数
+    uint32_t count_before(int list, const T& element, int list_id) const
+    {
+        if(list < list_id) return lists_[list]->get_upper_index(element) - 1;
+
+        return lists_[list]->get_lower_index(element) - 1;
+    }
+
+    // 候选区间的中点
+    struct Candidate
+    {
+        T element;
+        int list_id;
+        uint32_t index;
+        uint32_t weight;                // 候选区间的大小
+    };
+
+private:
+    std::vector<const List*> lists_;
+};
+
+template<typename T, typename Compare, typename Traits>
+bool SkipListMerger<T, Compare, Traits>::select(uint64_t rank, int& list_id, uint32_t& index) const
+{
+    if(rank == 0 || rank > length()) return false;
+
+    int list_num = static_cast<int>(lists_.size());
+    std::vector<uint32_t> lo(list_num, 1);              // 各表的候选区间[lo, hi]
+    std::vector<uint32_t> hi(list_num);
+    std::vector<uint32_t> before(list_num);
+    for(int i = 0; i < list_num; ++i)
+        hi[i] = lists_[i]->length();
+
+    std::vector<Candidate> cands;
+    Compare cmp;
+    for(;;)
+    {
+        cands.clear();
+        uint64_t total_weight = 0;
+        for(int i = 0; i < list_num; ++i)
+        {
+            if(lo[i] > hi[i]) continue;
+
+            Candidate cand;
+            cand.index = lo[i] + (hi[i] - lo[i]) / 2;
+            cand.element = *lists_[i]->find(cand.index);
+            cand.list_id = i;
+            cand.weight = hi[i] - lo[i] + 1;
+            cands.push_back(cand);
+            total_weight += cand.weight;
+        }
+
+        // 候选区间里一定包含目标，区间全空说明各表在调用期间被修改了
+        if(cands.empty()) return false;
+
+        // 按全局顺序取加权中位数
+        std::sort(cands.begin(), cands.end(), [&cmp](const Candidate& lhs, const Candidate& rhs) {
+            if(cmp(lhs.element, rhs.element)) return true;
+            if(cmp(rhs.element, lhs.element)) return false;
+            return lhs.list_id < rhs.list_id;
+        });
+
+        size_t pivot = 0;
+        uint64_t weight = 0;
+        for(; pivot < cands.size(); ++pivot)
+        {
+            weight += cands[pivot].weight;
+            if(weight * 2 >= total_weight) break;
+        }
+
+        const Candidate& cand = cands[pivot];
+        uint64_t pivot_rank = 1;
+        for(int i = 0; i < list_num; ++i)
+        {
+            before[i] = i == cand.list_id ? cand.index - 1 : count_before(i, cand.element, cand.list_id);
+            pivot_rank += before[i];
+        }
+
+        if(pivot_rank == rank)
+        {
+            list_id = cand.list_id;
+            index = cand.index;
+            return true;
+        }
+
+        for(int i = 0; i < list_num; ++i)
+        {
+            if(pivot_rank < rank)
+            {
+                uint32_t not_after = i == cand.list_id ? cand.index : before[i];
+                lo[i] = std::max(lo[i], not_after + 1);
+            }
+            else
+                hi[i] = std::min(hi[i], before[i]);
+        }
+    }
+}
+
+template<typename T, typename Compare, typename Traits>
+typename SkipListMerger<T, Compare, Traits>::Iterator SkipListMerger<T, Compare, Traits>::seek(uint64_t rank) const
+{
+    Iterator it(this);
+    int list_id = 0;
+    uint32_t index = 0;
+    if(!select(rank, list_id, index)) return it;
+
+    // 各表中排在目标之前的元素都跳过，从目标开始建堆
+    const T element = *lists_[list_id]->find(index);
+    for(int i = 0; i < static_cast<int>(lists_.size()); ++i)
+    {
+        uint32_t pos = i == list_id ? index : count_before(i, element, list_id) + 1;
+        it.cursors_.push_back(lists_[i]->find(pos));
+        if(it.cursors_.back() != lists_[i]->end())
+            it.heap_.push_back(i);
+    }
+
+    std::make_heap(it.heap_.begin(), it.heap_.end(), typename Iterator::Greater(it.cursors_));
+
+    return it;
+}
+
+#endif
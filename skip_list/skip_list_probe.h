@@ -0,0 +1,68 @@
+/*
+ * File        : skip_list_probe.h
+ * Created Date: 2026-10-19 01:27:40
+ * Author      : philma
+ * Desc        : 跳跃表热路径上的USDT静态探针，编译时定义SKIP_LIST_USDT才生效，需要sys/sdt.h（systemtap-sdt-dev）
+ *               探针在未被追踪时只是一条nop，provider为skip_list，bpftrace中按 usdt:./a.out:skip_list:find_return 的方式挂载
+ *               探针及参数（list为表的内存头地址，用于区分多个表）：
+ *                 find_entry(list)                         find_return(list, found, hops, cmps)
+ *                 get_index_entry(list)                    get_index_return(list, rank, hops, cmps)
+ *                 insert_entry(list)                       insert_return(list, ok, level, hops, cmps)
+ *                 erase_entry(list)                        erase_return(list, count, hops, cmps)
+ *                 alloc_fail(list, alloc_size, mem_size)   level_change(list, old_level_num, new_level_num)
+ *                 insert_bulk(list, path, count)           path为SLBulkPath
+ *                 erase_if(list, count, walked)            walked为沿第0层走过的节点数
+ *               hops为下降过程中前进的节点数（查找深度），cmps为比较次数，由当前线程在entry时清零、下降时累加
+ *               alloc_fail在节点区用完时报节点区的已分配大小和上限，在元素外部数据的分配区用完时报分配区的已切分大小和总大小
+ *               不定义SKIP_LIST_USDT时所有宏为空，计数代码也不会生成
+ */
+
+#ifndef SKIP_LIST_PROBE_H
+#define SKIP_LIST_PROBE_H
+
+#ifdef SKIP_LIST_USDT
+
+#include <sys/sdt.h>
+#include <cstdint>
+
+// 当前线程一次操作中的下降统计
+struct SLProbeCount
+{
+    uint32_t hops;
+    uint32_t cmps;
+};
+
+inline SLProbeCount& sl_probe_count()
+{
+    static thread_local SLProbeCount count;
+    return count;
+}
+
+#define SL_PROBE_HOP() (++sl_probe_count().hops)
+#define SL_PROBE_CMP() (++sl_probe_count().cmps)
+
+// 入口探针，同时清零当前线程的统计
+#define SL_PROBE_ENTRY(name, list) \
+    do { sl_probe_count().hops = 0; sl_probe_count().cmps = 0; DTRACE_PROBE1(skip_list, name, list); } while(0)
+
+// 返回探针，带上统计
+#define SL_PROBE_RETURN(name, list, ret) \
+    DTRACE_PROBE4(skip_list, name, list, ret, sl_probe_count().hops, sl_probe_count().cmps)
+
+#define SL_PROBE_RETURN_LEVEL(name, list, ret, level) \
+    DTRACE_PROBE5(skip_list, name, list, ret, level, sl_probe_count().hops, sl_probe_count().cmps)
+
+#define SL_PROBE3(name, a, b, c) DTRACE_PROBE3(skip_list, name, a, b, c)
+
+#else
+
+#define SL_PROBE_HOP() ((void)0)
+#define SL_PROBE_CMP() ((void)0)
+#define SL_PROBE_ENTRY(name, list) do {} while(0)
+#define SL_PROBE_RETURN(name, list, ret) do {} while(0)
+#define SL_PROBE_RETURN_LEVEL(name, list, ret, level) do { (void)(level); } while(0)
+#define SL_PROBE3(name, a, b, c) do {} while(0)
+
+#endif
+
+#endif
@@ -0,0 +1,363 @@
+/*
+ * File        : skip_list_publish.h
+ * Created Date: 2026-10-18 23:06:15
+ * Author      : philma
+ * Desc        : 双缓冲发布的跳跃表，用于整表重建：可以放在共享内存中，一个写者和多个读者（线程/进程）同时使用
+ *               布局：控制块 | 区域0 | 区域1，控制块中记录已发布的代数(generation)，第g代的表在区域g%2中
+ *               写者在非活跃区域上重新初始化并批量装载，装载完成后把代数加1，读者之后的查询就切到新表上
+ *               读者先attach_reader()占用一个读者槽，每批查询前调用enter()，在槽上登记看到的代数，
+ *               再确认代数没变，代数变了就重新挂接到新区域；查询完调用leave()清除登记
+ *               旧区域只有在没有读者登记旧代数时才会被释放（丢弃物理页）或者重新装载
+ *               读者拿到的表只能读，且不要开启finger缓存：同一区域重新装载后修改版本号会从0开始
+ */
+
+#ifndef SKIP_LIST_PUBLISH_H
+#define SKIP_LIST_PUBLISH_H
+
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "skip_list.h"
+
+template<typename T, typename Compare = std::less<T>, typename Traits = SLDefaultTraits>
+class SkipListPublisher
+{
+public:
+    typedef SkipList<T, Compare, Traits> List;
+
+    static const int MAX_READER_NUM = 64;       // 最多同时使用的读者数
+
+    /*
+     * 初始化，is_raw为false时表示挂接到已经初始化过的内存上
+     * 两个区域平分控制块之后的内存，每个区域都要能放下max_sl_len个元素（以及arena_size大小的分配区）
+     * 不能在有其他读者或写者正在使用这段内存时以is_raw=true初始化
+     */
+    bool init(void* mem, size_t mem_size, uint32_t max_sl_len, bool is_raw = true, size_t arena_size = 0);
+
+    /*
+     * 根据每个区域中跳跃表的最大长度，获取需要的最大内存大小
+     */
+    size_t max_mem_size(uint32_t max_sl_len, size_t arena_size = 0) const
+    {
+        return header_size() + 2 * align(List().max_mem_size(max_sl_len, arena_size));
+    }
+
+    /*
+     * 开始装载：在非活跃区域上重新初始化一个空表并返回，写者往里插入元素后调用publish()发布
+     * 同时只能有一个写者在装载；旧区域还有读者登记时返回nullptr
+     */
+    List* begin_load();
+
+    /*
+     * 发布装载好的表，代数加1，之后进入的读者都使用新表
+     */
+    bool publish();
+
+    /*
+     * 放弃本次装载，已发布的表不受影响
+     */
+    void abort_load();
+
+    /*
+     * 释放上一代的区域：没有读者还登记着旧代数时，丢弃旧区域的物理页，返回true
+     * 还有读者在使用旧表时返回false，稍后再试；begin_load()时也会做同样的检查，不需要先调用本函数
+     * 写者正在装载时返回false
+     */
+    bool release_old();
+
+    /*
+     * 占用一个读者槽，返回槽号，之后该读者的enter/leave都传入这个槽号；返回-1表示槽已用完
+     */
+    int attach_reader();
+
+    /*
+     * 释放读者槽
+     */
+    void detach_reader(int rid);
+
+    /*
+     * 一批查询开始前调用，返回当前已发布的表，代数变化时自动重新挂接；还没有发布过时返回nullptr
+     * 返回的表在leave()之前一直有效，即使期间写者发布了新表
+     */
+    const List* enter(int rid);
+
+    /*
+     * 一批查询结束后调用，不再阻止旧区域的释放
+     */
+    void leave(int rid) { __atomic_store_n(&header_->readers[rid].generation, 0, __ATOMIC_RELEASE); }
+
+    /*
+     * 已发布的代数，0表示还没有发布过
+     */
+    uint64_t generation() const { return __atomic_load_n(&header_->generation, __ATOMIC_ACQUIRE); }
+
+    /*
+     * 获取内部的错误信息
+     */
+    const std::string& err_msg() const { return err_msg_; }
+
+private:
+
+    static const uint32_t MAGIC_NUM = 0x50554253;
+
+    struct ReaderSlot
+    {
+        uint32_t in_use;                // 槽是否被占用
+        uint32_t pad0;
+        uint64_t generation;            // 读者正在使用的代数，0表示不在查询中
+        char pad1[48];                  // 各槽独占一个cache line
+    };
+
+    struct PublishHeader
+    {
+        uint32_t magic_num;
+        uint32_t max_sl_len;            // 每个区域中跳跃表的最大长度
+        size_t mem_size;                // 总内存大小
+        size_t region_size;             // 每个区域的大小
+        size_t arena_size;              // 每个区域的分配区大小
+        uint64_t generation;            // 已发布的代数
+        uint64_t released;              // 上一代区域被释放时的代数，等于generation表示旧区域已释放
+        uint32_t loading;               // 是否有写者正在装载
+        char pad[12];
+        ReaderSlot readers[MAX_READER_NUM];
+    };
+
+    // 读者在本进程内的挂接状态，每个读者槽同时只被一个线程使用
+    struct ReaderView
+    {
+        List list[2];
+        uint64_t generation[2] = {0, 0}; // list[i]挂接时区域i的代数
+    };
+
+    static size_t align(size_t size) { return (size + 63) & (~static_cast<size_t>(63)); }
+
+    static size_t header_size() { return align(sizeof(PublishHeader)); }
+
+    char* region(uint64_t generation) const
+    {
+        return reinterpret_cast<char*>(header_) + header_size() + (generation & 1) * header_->region_size;
+    }
+
+    // 是否还有读者登记着比当前更旧的代数
+    bool old_in_use(uint64_t generation) const;
+
+private:
+    PublishHeader* header_ = nullptr;
+    List loader_;
+    std::vector<ReaderView> views_;
+    std::string err_msg_;
+};
+
+template<typename T, typename Compare, typename Traits>
+bool SkipListPublisher<T, Compare, Traits>::init(void* mem, size_t mem_size, uint32_t max_sl_len, bool is_raw, size_t arena_size)
+{
+    if(!mem)
+    {
+        err_msg_ = "mem is nullptr";
+        return false;
+    }
+
+    if(mem_size < max_mem_size(max_sl_len, arena_size))
+    {
+        err_msg_ = "mem_size not enough";
+        return false;
+    }
+
+    header_ = reinterpret_cast<PublishHeader*>(mem);
+    if(!is_raw)
+    {
+        if(header_->magic_num != MAGIC_NUM || header_->mem_size != mem_size || header_->max_sl_len != max_sl_len
+            || header_->arena_size != arena_size)
+        {
+            err_msg_ = "publish header check err";
+            return false;
+        }
+    }
+    else
+    {
+        memset(header_, 0, header_size());
+        header_->max_sl_len = max_sl_len;
+        header_->mem_size = mem_size;
+        header_->region_size = ((mem_size - header_size()) / 2) & (~static_cast<size_t>(63));
+        header_->arena_size = arena_size;
+        header_->generation = 0;
+        header_->released = 0;
+        __atomic_store_n(&header_->magic_num, MAGIC_NUM, __ATOMIC_RELEASE);
+    }
+
+    views_.assign(MAX_READER_NUM, ReaderView());
+
+    return true;
+}
+
+template<typename T, typename Compare, typename Traits>
+typename SkipListPublisher<T, Compare, Traits>::List* SkipListPublisher<T, Compare, Traits>::begin_load()
+{
+    uint32_t expected = 0;
+    if(!__atomic_compare_exchange_n(&header_->loading, &expected, 1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+    {
+        err_msg_ = "another load in progress";
+        return nullptr;
+    }
+
+    uint64_t generation = __atomic_load_n(&header_->generation, __ATOMIC_SEQ_CST);
+    if(header_->released != generation && old_in_use(generation))
+    {
+        __atomic_store_n(&header_->loading, 0, __ATOMIC_RELEASE);
+        err_msg_ = "old region still in use";
+        return nullptr;
+    }
+
+    if(!loader_.init(region(generation + 1), header_->region_size, header_->max_sl_len, true, header_->arena_size))
+    {
+        __atomic_store_n(&header_->loading, 0, __ATOMIC_RELEASE);
+        err_msg_ = loader_.err_msg();
+        return nullptr;
+    }
+
+    return &loader_;
+}
+
+template<typename T, typename Compare, typename Traits>
+bool SkipListPublisher<T, Compare, Traits>::publish()
+{
+    if(!__atomic_load_n(&header_->loading, __ATOMIC_RELAXED))
+    {
+        err_msg_ = "no load in progress";
+        return false;
+    }
+
+    // 新表的所有写入在代数变化之前对读者可见
+    __atomic_store_n(&header_->generation, header_->generation + 1, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&header_->loading, 0, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+template<typename T, typename Compare, typename Traits>
+void SkipListPublisher<T, Compare, Traits>::abort_load()
+{
+    __atomic_store_n(&header_->loading, 0, __ATOMIC_RELEASE);
+}
+
+template<typename T, typename Compare, typename Traits>
+bool SkipListPublisher<T, Compare, Traits>::release_old()
+{
+    // 和begin_load()一样占住装载标记，释放期间旧区域不会被重新装载
+    uint32_t expected = 0;
+    if(!__atomic_compare_exchange_n(&header_->loading, &expected, 1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+    {
+        err_msg_ = "load in progress";
+        return false;
+    }
+
+    uint64_t generation = __atomic_load_n(&header_->generation, __ATOMIC_SEQ_CST);
+    if(header_->released == generation)
+    {
+        __atomic_store_n(&header_->loading, 0, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    if(old_in_use(generation))
+    {
+        __atomic_store_n(&header_->loading, 0, __ATOMIC_RELEASE);
+        return false;
+    }
+
+    // 区域重新装载前会重新初始化，内容可以直接丢弃；共享内存要用MADV_REMOVE才能真正归还物理页
+    bool ok = true;
+    size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t begin = reinterpret_cast<uintptr_t>(region(generation + 1));
+    uintptr_t end = begin + header_->region_size;
+    begin = (begin + page_size - 1) & ~(page_size - 1);
+    end &= ~(page_size - 1);
+    if(begin < end)
+    {
+        void* addr = reinterpret_cast<void*>(begin);
+        if(madvise(addr, end - begin, MADV_REMOVE) != 0 && madvise(addr, end - begin, MADV_DONTNEED) != 0)
+        {
+            err_msg_ = "madvise err";
+            ok = false;
+        }
+    }
+
+    if(ok) header_->released = generation;
+    __atomic_store_n(&header_->loading, 0, __ATOMIC_RELEASE);
+
+    return ok;
+}
+
+template<typename T, typename Compare, typename Traits>
+bool SkipListPublisher<T, Compare, Traits>::old_in_use(uint64_t generation) const
+{
+    for(int i = 0; i < MAX_READER_NUM; ++i)
+    {
+        uint64_t reader_generation = __atomic_load_n(&header_->readers[i].generation, __ATOMIC_SEQ_CST);
+        if(reader_generation && reader_generation < generation) return true;
+    }
+
+    return false;
+}
+
+template<typename T, typename Compare, typename Traits>
+int SkipListPublisher<T, Compare, Traits>::attach_reader()
+{
+    for(int i = 0; i < MAX_READER_NUM; ++i)
+    {
+        uint32_t expected = 0;
+        if(__atomic_compare_exchange_n(&header_->readers[i].in_use, &expected, 1,
+            false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        {
+            __atomic_store_n(&header_->readers[i].generation, 0, __ATOMIC_RELEASE);
+            return i;
+        }
+    }
+
+    err_msg_ = "no free reader slot";
+    return -1;
+}
+
+template<typename T, typename Compare, typename Traits>
+void SkipListPublisher<T, Compare, Traits>::detach_reader(int rid)
+{
+    __atomic_store_n(&header_->readers[rid].generation, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&header_->readers[rid].in_use, 0, __ATOMIC_RELEASE);
+}
+
+template<typename T, typename Compare, typename Traits>
+const typename SkipListPublisher<T, Compare, Traits>::List* SkipListPublisher<T, Compare, Traits>::enter(int rid)
+{
+    ReaderSlot& slot = header_->readers[rid];
+    uint64_t generation = 0;
+    for(;;)
+    {
+        generation = __atomic_load_n(&header_->generation, __ATOMIC_SEQ_CST);
+        if(!generation)
+        {
+            __atomic_store_n(&slot.generation, 0, __ATOMIC_RELEASE);
+            return nullptr;
+        }
+
+        // 先登记再确认，写者在登记之后检查读者槽时一定能看到；确认失败说明期间发布了新表，重试
+        __atomic_store_n(&slot.generation, generation, __ATOMIC_SEQ_CST);
+        if(__atomic_load_n(&header_->generation, __ATOMIC_SEQ_CST) == generation) break;
+    }
+
+    ReaderView& view = views_[rid];
+    int i = static_cast<int>(generation & 1);
+    if(view.generation[i] != generation)
+    {
+        if(!view.list[i].init(region(generation), header_->region_size, header_->max_sl_len, false))
+        {
+            __atomic_store_n(&slot.generation, 0, __ATOMIC_RELEASE);
+            err_msg_ = view.list[i].err_msg();
+            return nullptr;
+        }
+
+        view.generation[i] = generation;
+    }
+
+    return &view.list[i];
+}
+
+#endif
@@ -0,0 +1,260 @@
+/*
+ * File        : skip_list_trace.h
+ * Created Date: 2026-10-18 10:02:11
+ * Author      : philma
+ * Desc        : 跳跃表操作轨迹的记录与读取，用于线下按真实访问模式回放压测
+ *               轨迹文件格式：文件头(SLTraceHeader) + 若干条记录，每条记录为1字节操作类型加上参数
+ *               （元素原始字节，或者4字节的位置索引），元素要求是可以按字节拷贝的类型
+ */
+
+#ifndef SKIP_LIST_TRACE_H
+#define SKIP_LIST_TRACE_H
+
+#include <cstdio>
+#include <type_traits>
+#include "skip_list.h"
+
+enum SLTraceOp
+{
+    SL_TRACE_INSERT = 1,            // insert(element)
+    SL_TRACE_ERASE = 2,             // erase(element)
+    SL_TRACE_FIND = 3,              // find(element)
+    SL_TRACE_FIND_INDEX = 4,        // find(index)
+    SL_TRACE_GET_INDEX = 5,         // get_index(element)
+};
+
+struct SLTraceHeader
+{
+    uint32_t magic_num;
+    uint16_t version;
+    uint16_t elem_size;             // 元素大小，回放时用于校验元素类型
+};
+
+static const uint32_t SL_TRACE_MAGIC_NUM = 0x534c5452;
+static const uint16_t SL_TRACE_VERSION = 1;
+
+/*
+ * 带轨迹记录的跳跃表访问入口，接口同SkipList，调用时先写轨迹再转发给跳跃表
+ * 不需要记录时直接使用SkipList即可，没有额外开销；回放从空表开始，所以应在表为空时开始记录
+ * 写轨迹失败（如磁盘满）不影响对跳跃表的操作，之后不再记录，close()返回false，原因见err_msg()
+ */
+template<typename T, typename Compare = std::less<T>, typename Traits = SLDefaultTraits>
+class SkipListTracer
+{
+    static_assert(std::is_trivially_copyable<T>::value, "trace element must be trivially copyable");
+
+public:
+    typedef SkipList<T, Compare, Traits> List;
+    typedef typename List::Iterator Iterator;
+
+    explicit SkipListTracer(List* skip_list)
+        :skip_list_(skip_list)
+    {}
+
+    ~SkipListTracer() { close(); }
+
+    SkipListTracer(const SkipListTracer&) = delete;
+    SkipListTracer& operator=(const SkipListTracer&) = delete;
+
+    /*
+     * 打开轨迹文件，文件已存在则覆盖
+     */
+    bool open(const char* path)
+    {
+        close();
+        write_err_ = false;
+        err_msg_.clear();
+        fp_ = fopen(path, "wb");
+        if(!fp_)
+        {
+            err_msg_ = std::string("open trace file failed: ") + path;
+            return false;
+        }
+
+        SLTraceHeader header;
+        header.magic_num = SL_TRACE_MAGIC_NUM;
+        header.version = SL_TRACE_VERSION;
+        header.elem_size = sizeof(T);
+        if(fwrite(&header, sizeof(header), 1, fp_) != 1)
+        {
+            err_msg_ = "write trace header failed";
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    /*
+     * 关闭轨迹文件，缓冲区中的记录会写入文件
+     * 返回false表示记录过程中或者关闭时写文件失败，轨迹不完整
+     */
+    bool close()
+    {
+        if(fp_)
+        {
+            if(fclose(fp_) != 0 && !write_err_)
+            {
+                write_err_ = true;
+                err_msg_ = "close trace file failed";
+            }
+            fp_ = nullptr;
+        }
+
+        return !write_err_;
+    }
+
+    /*
+     * 到目前为止的记录是否都写成功了
+     */
+    bool good() const { return !write_err_; }
+
+    bool insert(const T& element)
+    {
+        record(SL_TRACE_INSERT, &element, sizeof(element));
+        return skip_list_->insert(element);
+    }
+
+    uint32_t erase(const T& element)
+    {
+        record(SL_TRACE_ERASE, &element, sizeof(element));
+        return skip_list_->erase(element);
+    }
+
+    Iterator find(const T& element) const
+    {
+        record(SL_TRACE_FIND, &element, sizeof(element));
+        return skip_list_->find(element);
+    }
+
+    Iterator find(uint32_t index) const
+    {
+        record(SL_TRACE_FIND_INDEX, &index, sizeof(index));
+        return skip_list_->find(index);
+    }
+
+    uint32_t get_index(const T& element) const
+    {
+        record(SL_TRACE_GET_INDEX, &element, sizeof(element));
+        return skip_list_->get_index(element);
+    }
+
+    const std::string& err_msg() const { return err_msg_; }
+
+private:
+
+    // 第一次写失败后不再记录：半条记录之后的内容回放时无法对齐
+    void record(uint8_t op, const void* arg, size_t arg_size) const
+    {
+        if(!fp_ || write_err_) return;
+
+        if(fputc(op, fp_) == EOF || fwrite(arg, arg_size, 1, fp_) != 1)
+        {
+            write_err_ = true;
+            err_msg_ = "write trace record failed";
+        }
+    }
+
+private:
+    List* skip_list_;
+    FILE* fp_ = nullptr;
+    mutable bool write_err_ = false;    // 查找接口是const的，也要能记下写失败
+    mutable std::string err_msg_;
+};
+
+/*
+ * 轨迹记录，element和index根据op只有一个有效
+ */
+template<typename T>
+struct SLTraceRecord
+{
+    uint8_t op;
+    uint32_t index;
+    T element;
+};
+
+/*
+ * 顺序读取轨迹文件
+ */
+template<typename T>
+class SLTraceReader
+{
+    static_assert(std::is_trivially_copyable<T>::value, "trace element must be trivially copyable");
+
+public:
+    SLTraceReader() = default;
+    ~SLTraceReader() { close(); }
+
+    SLTraceReader(const SLTraceReader&) = delete;
+    SLTraceReader& operator=(const SLTraceReader&) = delete;
+
+    bool open(const char* path)
+    {
+        close();
+        fp_ = fopen(path, "rb");
+        if(!fp_)
+        {
+            err_msg_ = std::string("open trace file failed: ") + path;
+            return false;
+        }
+
+        SLTraceHeader header;
+        if(fread(&header, sizeof(header), 1, fp_) != 1
+            || header.magic_num != SL_TRACE_MAGIC_NUM || header.version != SL_TRACE_VERSION)
+        {
+            err_msg_ = "trace header check err";
+            close();
+            return false;
+        }
+
+        if(header.elem_size != sizeof(T))
+        {
+            err_msg_ = "trace elem_size not match";
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void close()
+    {
+        if(fp_)
+        {
+            fclose(fp_);
+            fp_ = nullptr;
+        }
+    }
+
+    /*
+     * 读取下一条记录，返回false表示读完或者文件损坏（err_msg非空）
+     */
+    bool next(SLTraceRecord<T>& rec)
+    {
+        int op = fgetc(fp_);
+        if(op == EOF) return false;
+
+        rec.op = static_cast<uint8_t>(op);
+        size_t ok = 0;
+        if(rec.op == SL_TRACE_FIND_INDEX)
+            ok = fread(&rec.index, sizeof(rec.index), 1, fp_);
+        else if(rec.op >= SL_TRACE_INSERT && rec.op <= SL_TRACE_GET_INDEX)
+            ok = fread(&rec.element, sizeof(rec.element), 1, fp_);
+
+        if(ok != 1)
+        {
+            err_msg_ = "trace record broken";
+            return false;
+        }
+
+        return true;
+    }
+
+    const std::string& err_msg() const { return err_msg_; }
+
+private:
+    FILE* fp_ = nullptr;
+    std::string err_msg_;
+};
+
+#endif
@@ -0,0 +1,656 @@
+/*
+ * File        : skip_list_wal.h
+ * Created Date: 2026-10-19 00:12:37
+ * Author      : philma
+ * Desc        : 跳跃表的预写日志(WAL)，插入删除成功后追加一条记录（1字节操作类型加元素原始字节）到内存缓冲，
+ *               后台线程按组提交：每隔group_commit_us把缓冲中的记录作为一帧写入日志文件并fdatasync，
+ *               多次修改共用一次fsync，修改路径上只有一次加锁和内存拷贝；需要确认落盘时调用sync()
+ *               帧格式：帧头(SLWalFrame) + 若干条记录，帧头中有首条记录的序号(lsn)和校验和，崩溃时写了一半的帧在恢复时丢弃
+ *               checkpoint()把区域中用到的部分写入检查点文件（先写临时文件再rename），之后同样用rename换成只有文件头的新日志
+ *               写日志失败后日志末尾是不完整的帧，之后不再提交，也不再接受修改，checkpoint成功后恢复
+ *               恢复：recover()先把检查点读入内存并挂接，再重放日志中序号比检查点新的记录
+ *               元素要求是可以按字节拷贝、且不引用区域内其他数据的类型（不支持SLString这类放在分配区上的类型）
+ */
+
+#ifndef SKIP_LIST_WAL_H
+#define SKIP_LIST_WAL_H
+
+#include <mutex>
+#include <condition_variable>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "skip_list.h"
+
+enum SLWalOp
+{
+    SL_WAL_INSERT = 1,              // insert(element)
+    SL_WAL_ERASE = 2,               // erase(element)
+};
+
+struct SLWalHeader
+{
+    uint32_t magic_num;
+    uint16_t version;
+    uint16_t elem_size;             // 元素大小，恢复时用于校验元素类型
+    uint64_t base_lsn;              // 日志清空时的序号，日志中的记录都比它新
+};
+
+struct SLWalFrame
+{
+    uint32_t size;                  // 帧中记录的总字节数
+    uint32_t checksum;              // first_lsn和记录的校验和
+    uint64_t first_lsn;             // 帧中第一条记录的序号
+};
+
+struct SLWalCheckpoint
+{
+    uint32_t magic_num;
+    uint32_t elem_size;
+    uint64_t lsn;                   // 检查点包含的最后一条记录的序号
+    size_t mem_size;                // 区域总大小，恢复时的内存大小必须相同
+    size_t node_bytes;              // 区域开头写入的字节数，即节点部分已申请的大小
+    size_t arena;                   // 分配区在区域中的偏移，0表示没有
+    size_t arena_bytes;             // 分配区写入的字节数
+};
+
+static const uint32_t SL_WAL_MAGIC_NUM = 0x534c574c;
+static const uint32_t SL_WAL_CKPT_MAGIC_NUM = 0x534c434b;
+static const uint16_t SL_WAL_VERSION = 1;
+
+template<typename T, typename Compare = std::less<T>, typename Traits = SLDefaultTraits>
+class SkipListWAL
+{
+    static_assert(std::is_trivially_copyable<T>::value, "wal element must be trivially copyable");
+    static_assert(!Traits::SEGMENTED, "wal checkpoint does not support SEGMENTED");
+
+public:
+    static const size_t MAX_BUFFER_SIZE = 1 << 20;  // 缓冲超过这么多字节时不等时间到，立即提交
+
+    explicit SkipListWAL(SkipList<T, Compare, Traits>* skip_list)
+        :skip_list_(skip_list)
+    {}
+
+    ~SkipListWAL() { close(); }
+
+    SkipListWAL(const SkipListWAL&) = delete;
+    SkipListWAL& operator=(const SkipListWAL&) = delete;
+
+    /*
+     * 从检查点和日志恢复跳跃表，mem/mem_size/max_sl_len/arena_size同SkipList::init
+     * 检查点文件不存在时从空表开始重放；日志文件不存在时只恢复检查点
+     * 在open之前调用
+     */
+    bool recover(const char* ckpt_path, const char* log_path, void* mem, size_t mem_size, uint32_t max_sl_len,
+        size_t arena_size = 0);
+
+    /*
+     * 打开日志文件并启动提交线程，文件已存在时截掉末尾不完整的帧后继续追加
+     * 日志中的记录都比跳跃表旧时（checkpoint换日志之前崩溃留下的）换成只有文件头的新日志
+     * group_commit_us为组提交的时间预算，一条记录最迟在大约这么长时间后落盘
+     */
+    bool open(const char* log_path, uint32_t group_commit_us = 1000);
+
+    /*
+     * 提交缓冲中的记录，停止提交线程并关闭日志文件
+     */
+    void close();
+
+    /*
+     * 插入一个元素，成功时追加日志记录；返回时记录还不一定落盘
+     * 日志写入失败之后不再修改跳跃表，返回false，err_msg为写日志的错误，直到checkpoint成功
+     */
+    bool insert(const T& element)
+    {
+        if(failed()) return false;
+        if(!skip_list_->insert(element))
+        {
+            err_msg_ = skip_list_->err_msg();
+            return false;
+        }
+
+        append(SL_WAL_INSERT, element);
+        return true;
+    }
+
+    /*
+     * 删除元素，如果有多个相同元素，则均删除，删除了元素时追加日志记录
+     * 返回删除的元素个数；日志写入失败之后同insert，不修改跳跃表，返回0
+     */
+    uint32_t erase(const T& element)
+    {
+        if(failed()) return 0;
+
+        uint32_t count = skip_list_->erase(element);
+        if(count) append(SL_WAL_ERASE, element);
+
+        return count;
+    }
+
+    /*
+     * 等待到目前为止的所有记录落盘，写文件或fsync失败时返回false
+     */
+    bool sync();
+
+    /*
+     * 把跳跃表写成检查点文件，成功后换成空日志，写日志失败过时也由此恢复
+     * 要和修改在同一个线程中调用
+     */
+    bool checkpoint(const char* ckpt_path);
+
+    /*
+     * 最后一条记录的序号
+     */
+    uint64_t lsn() const { return lsn_; }
+
+    /*
+     * 已经落盘的最后一条记录的序号
+     */
+    uint64_t durable_lsn()
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return durable_lsn_;
+    }
+
+    const std::string& err_msg() const { return err_msg_; }
+
+private:
+
+    static const size_t RECORD_SIZE = 1 + sizeof(T);
+
+    static uint32_t checksum(uint64_t first_lsn, const char* data, size_t size)
+    {// FNV-1a
+        uint32_t hash = 2166136261u;
+        const char* lsn_bytes = reinterpret_cast<const char*>(&first_lsn);
+        for(size_t i = 0; i < sizeof(first_lsn); ++i)
+            hash = (hash ^ static_cast<uint8_t>(lsn_bytes[i])) * 16777619u;
+        for(size_t i = 0; i < size; ++i)
+            hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+
+        return hash;
+    }
+
+    static bool write_all(int fd, const void* data, size_t size)
+    {
+        const char* p = reinterpret_cast<const char*>(data);
+        while(size)
+        {
+            ssize_t n = ::write(fd, p, size);
+            if(n < 0)
+            {
+                if(errno == EINTR) continue;
+                return false;
+            }
+
+            p += n;
+            size -= n;
+        }
+
+        return true;
+    }
+
+    static bool read_all(int fd, void* data, size_t size)
+    {
+        char* p = reinterpret_cast<char*>(data);
+        while(size)
+        {
+            ssize_t n = ::read(fd, p, size);
+            if(n < 0 && errno == EINTR) continue;
+            if(n <= 0) return false;
+
+            p += n;
+            size -= n;
+        }
+
+        return true;
+    }
+
+    // 提交线程写日志失败过时返回true并设置err_msg
+    // 失败之后日志中已经有了不完整的帧，scan在此处停下，之后的帧都无法重放，所以不再提交，也不再接受修改；
+    // 检查之后、追加之前才失败的那条修改留在内存中，不会落盘
+    bool failed()
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if(io_err_) err_msg_ = "write wal failed, checkpoint to continue";
+
+        return io_err_;
+    }
+
+    // 写日志文件头
+    bool write_header(int fd, uint64_t base_lsn)
+    {
+        SLWalHeader header;
+        header.magic_num = SL_WAL_MAGIC_NUM;
+        header.version = SL_WAL_VERSION;
+        header.elem_size = sizeof(T);
+        header.base_lsn = base_lsn;
+
+        return write_all(fd, &header, sizeof(header)) && fdatasync(fd) == 0;
+    }
+
+    // 在log_path上换成只有文件头、起始序号为lsn_的新日志，返回新日志的fd，失败时返回-1
+    // 先写临时文件再rename，任何时刻崩溃，日志路径上都是完整的旧日志或新日志；rename还没有落盘，调用者负责sl_sync_dir
+    int reset_log(const std::string& log_path)
+    {
+        std::string tmp_log_path = log_path + ".tmp";
+        int fd = ::open(tmp_log_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0) return -1;
+        if(!write_header(fd, lsn_) || rename(tmp_log_path.c_str(), log_path.c_str()) != 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+
+        return fd;
+    }
+
+    // 顺序读出日志中完整的帧，对每条序号比after新的记录调用f，返回最后一个完整帧的结束位置，日志损坏时返回-1
+    template<typename F>
+    off_t scan(int fd, uint64_t after, uint64_t& last_lsn, F f);
+
+    void append(uint8_t op, const T& element)
+    {
+        std::unique_lock<std::mutex> guard(mutex_);
+        if(buffer_.empty()) first_lsn_ = lsn_ + 1;
+        buffer_.push_back(static_cast<char>(op));
+        buffer_.insert(buffer_.end(), reinterpret_cast<const char*>(&element),
+            reinterpret_cast<const char*>(&element) + sizeof(element));
+        ++lsn_;
+        if(buffer_.size() >= MAX_BUFFER_SIZE) cond_.notify_all();
+    }
+
+    // 提交线程
+    void run();
+
+    // 把缓冲作为一帧写入并fdatasync，调用时持有锁，写文件期间释放锁
+    void commit(std::unique_lock<std::mutex>& guard);
+
+private:
+    SkipList<T, Compare, Traits>* skip_list_;
+    int fd_ = -1;
+    std::string log_path_;
+    uint32_t group_commit_us_ = 1000;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::vector<char> buffer_;          // 还没有写入日志的记录
+    std::vector<char> writing_;         // 提交线程正在写的记录
+    bool committing_ = false;
+    bool stop_ = false;
+    bool io_err_ = false;
+    uint64_t lsn_ = 0;
+    uint64_t first_lsn_ = 0;            // 缓冲中第一条记录的序号
+    uint64_t durable_lsn_ = 0;
+    std::string err_msg_;
+};
+
+template<typename T, typename Compare, typename Traits>
+template<typename F>
+off_t SkipListWAL<T, Compare, Traits>::scan(int fd, uint64_t after, uint64_t& last_lsn, F f)
+{
+    SLWalHeader header;
+    if(lseek(fd, 0, SEEK_SET) != 0 || !read_all(fd, &header, sizeof(header))
+        || header.magic_num != SL_WAL_MAGIC_NUM || header.version != SL_WAL_VERSION)
+    {
+        err_msg_ = "wal header check err";
+        return -1;
+    }
+
+    if(header.elem_size != sizeof(T))
+    {
+        err_msg_ = "wal elem_size not match";
+        return -1;
+    }
+
+    // 日志比检查点新，中间的记录已经丢失
+    if(after != UINT64_MAX && header.base_lsn > after)
+    {
+        err_msg_ = "wal newer than checkpoint";
+        return -1;
+    }
+
+    off_t end = sizeof(header);
+    last_lsn = header.base_lsn;
+    std::vector<char> data;
+    SLWalFrame frame;
+    while(read_all(fd, &frame, sizeof(frame)))
+    {
+        // 帧不完整或校验失败，说明是崩溃时没写完的最后一帧，到此为止
+        if(frame.size == 0 || frame.size % RECORD_SIZE != 0 || frame.first_lsn != last_lsn + 1) break;
+
+        data.resize(frame.size);
+        if(!read_all(fd, &data[0], frame.size) || checksum(frame.first_lsn, &data[0], frame.size) != frame.checksum)
+            break;
+
+        for(size_t pos = 0; pos < frame.size; pos += RECORD_SIZE)
+        {
+            ++last_lsn;
+            if(last_lsn <= after) continue;
+
+            T element;
+            memcpy(static_cast<void*>(&element), &data[pos + 1], sizeof(T));
+            f(static_cast<uint8_t>(data[pos]), element);
+        }
+
+        end += sizeof(frame) + frame.size;
+    }
+
+    return end;
+}
+
+template<typename T, typename Compare, typename Traits>
+bool SkipListWAL<T, Compare, Traits>::recover(const char* ckpt_path, const char* log_path, void* mem, size_t mem_size,
+    uint32_t max_sl_len, size_t arena_size)
+{
+    uint64_t ckpt_lsn = 0;
+    int fd = ::open(ckpt_path, O_RDONLY);
+    if(fd >= 0)
+    {
+        SLWalCheckpoint ckpt;
+        bool ok = read_all(fd, &ckpt, sizeof(ckpt)) && ckpt.magic_num == SL_WAL_CKPT_MAGIC_NUM
+            && ckpt.elem_size == sizeof(T) && ckpt.mem_size == mem_size && ckpt.node_bytes <= mem_size
+            && (!ckpt.arena || ckpt.arena + ckpt.arena_bytes <= mem_size);
+        ok = ok && read_all(fd, mem, ckpt.node_bytes);
+        ok = ok && (!ckpt.arena || read_all(fd, reinterpret_cast<char*>(mem) + ckpt.arena, ckpt.arena_bytes));
+        ::close(fd);
+        if(!ok)
+        {
+            err_msg_ = "read checkpoint failed";
+            return false;
+        }
+
+        if(!skip_list_->init(mem, mem_size, max_sl_len, false, arena_size))
+        {
+            err_msg_ = skip_list_->err_msg();
+            return false;
+        }
+
+        ckpt_lsn = ckpt.lsn;
+    }
+    else if(!skip_list_->init(mem, mem_size, max_sl_len, true, arena_size))
+    {
+        err_msg_ = skip_list_->err_msg();
+        return false;
+    }
+
+    lsn_ = ckpt_lsn;
+    fd = ::open(log_path, O_RDONLY);
+    if(fd < 0) return true;
+
+    // 文件头不完整的日志是新建时崩溃留下的，没有记录
+    struct stat st;
+    if(fstat(fd, &st) == 0 && st.st_size < static_cast<off_t>(sizeof(SLWalHeader)))
+    {
+        ::close(fd);
+        return true;
+    }
+
+    bool ok = true;
+    uint64_t last_lsn = 0;
+    off_t end = scan(fd, ckpt_lsn, last_lsn, [&](uint8_t op, const T& element) {
+        if(op == SL_WAL_INSERT) ok = skip_list_->insert(element) && ok;
+        else if(op == SL_WAL_ERASE) skip_list_->erase(element);
+    });
+    ::close(fd);
+
+    if(end < 0) return false;
+
+    if(!ok)
+    {
+        err_msg_ = "replay insert failed";
+        return false;
+    }
+
+    if(last_lsn > lsn_) lsn_ = last_lsn;
+
+    return true;
+}
+
+template<typename T, typename Compare, typename Traits>
+bool SkipListWAL<T, Compare, Traits>::open(const char* log_path, uint32_t group_commit_us)
+{
+    close();
+
+    fd_ = ::open(log_path, O_RDWR | O_CREAT, 0644);
+    if(fd_ < 0)
+    {
+        err_msg_ = std::string("open wal file failed: ") + log_path;
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd_, &st) != 0)
+    {
+        err_msg_ = "stat wal file failed";
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    // 文件头不完整只会是新建文件时崩溃，还没有写过帧，当作空日志重写文件头
+    off_t end = 0;
+    if(st.st_size < static_cast<off_t>(sizeof(SLWalHeader)))
+    {
+        if(ftruncate(fd_, 0) != 0 || !write_header(fd_, lsn_))
+        {
+            err_msg_ = "write wal header failed";
+            ::close(fd_);
+            fd_ = -1;
+            return false;
+        }
+
+        end = sizeof(SLWalHeader);
+    }
+    else
+    {
+        uint64_t last_lsn = 0;
+        end = scan(fd_, lsn_, last_lsn, [](uint8_t, const T&) {});
+        if(end < 0)
+        {
+            ::close(fd_);
+            fd_ = -1;
+            return false;
+        }
+
+        if(last_lsn < lsn_)
+        {// checkpoint在检查点rename之后、换日志之前崩溃，日志中的记录都已包含在检查点中，换成新日志
+            ::close(fd_);
+            fd_ = reset_log(log_path);
+            if(fd_ < 0)
+            {
+                err_msg_ = "reset wal file failed";
+                return false;
+            }
+
+            // 新日志没落盘时不能追加，否则崩溃后这些帧跟着新日志一起丢失
+            if(!sl_sync_dir(log_path))
+            {
+                err_msg_ = "sync wal dir failed";
+                ::close(fd_);
+                fd_ = -1;
+                return false;
+            }
+
+            end = sizeof(SLWalHeader);
+        }
+        else
+        {
+            // 截掉末尾没写完的帧，新的帧接在最后一个完整帧之后
+            if(ftruncate(fd_, end) != 0)
+            {
+                err_msg_ = "truncate wal file failed";
+                ::close(fd_);
+                fd_ = -1;
+                return false;
+            }
+
+            lsn_ = last_lsn;
+        }
+    }
+
+    if(lseek(fd_, end, SEEK_SET) != end)
+    {
+        err_msg_ = "seek wal file failed";
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    log_path_ = log_path;
+    group_commit_us_ = group_commit_us;
+    durable_lsn_ = lsn_;
+    stop_ = false;
+    io_err_ = false;
+    thread_ = std::thread(&SkipListWAL::run, this);
+
+    return true;
+}
+
+template<typename T, typename Compare, typename Traits>
+void SkipListWAL<T, Compare, Traits>::close()
+{
+    if(fd_ < 0) return;
+
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+
+    ::close(fd_);
+    fd_ = -1;
+}
+
+template<typename T, typename Compare, typename Traits>
+bool SkipListWAL<T, Compare, Traits>::sync()
+{
+    std::unique_lock<std::mutex> guard(mutex_);
+    uint64_t target = lsn_;
+    cond_.notify_all();
+    while(durable_lsn_ < target && !io_err_)
+    {
+        if(!committing_ && !buffer_.empty()) commit(guard);
+        else cond_.wait(guard);
+    }
+
+    if(io_err_)
+    {
+        err_msg_ = "write wal failed";
+        return false;
+    }
+
+    return true;
+}
+
+template<typename T, typename Compare, typename Traits>
+void SkipListWAL<T, Compare, Traits>::run()
+{
+    std::unique_lock<std::mutex> guard(mutex_);
+    while(!stop_)
+    {
+        cond_.wait_for(guard, std::chrono::microseconds(group_commit_us_));
+        if(!committing_ && !buffer_.empty() && !io_err_) commit(guard);
+    }
+
+    while(committing_)
+        cond_.wait(guard);
+    if(!buffer_.empty() && !io_err_) commit(guard);
+}
+
+template<typename T, typename Compare, typename Traits>
+void SkipListWAL<T, Compare, Traits>::commit(std::unique_lock<std::mutex>& guard)
+{
+    committing_ = true;
+    writing_.swap(buffer_);
+    buffer_.clear();
+
+    SLWalFrame frame;
+    frame.size = static_cast<uint32_t>(writing_.size());
+    frame.first_lsn = first_lsn_;
+    frame.checksum = checksum(frame.first_lsn, &writing_[0], writing_.size());
+    uint64_t last_lsn = first_lsn_ + writing_.size() / RECORD_SIZE - 1;
+
+    // 写文件和fsync期间修改线程可以继续往buffer_中追加
+    guard.unlock();
+    bool ok = write_all(fd_, &frame, sizeof(frame)) && write_all(fd_, &writing_[0], writing_.size())
+        && fdatasync(fd_) == 0;
+    guard.lock();
+
+    committing_ = false;
+    if(ok) durable_lsn_ = last_lsn;
+    else io_err_ = true;
+    cond_.notify_all();
+}
+
+template<typename T, typename Compare, typename Traits>
+bool SkipListWAL<T, Compare, Traits>::checkpoint(const char* ckpt_path)
+{
+    typename SkipList<T, Compare, Traits>::MemHeader* mem_header = skip_list_->mem_header_;
+    SLWalCheckpoint ckpt;
+    memset(&ckpt, 0, sizeof(ckpt));
+    ckpt.magic_num = SL_WAL_CKPT_MAGIC_NUM;
+    ckpt.elem_size = sizeof(T);
+    ckpt.lsn = lsn_;
+    ckpt.mem_size = mem_header->mem_size;
+    ckpt.node_bytes = mem_header->alloc_size;
+    ckpt.arena = mem_header->arena;
+    ckpt.arena_bytes = mem_header->arena ? skip_list_->arena()->alloc_size() : 0;
+
+    std::string tmp_path = std::string(ckpt_path) + ".tmp";
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+    {
+        err_msg_ = std::string("open checkpoint file failed: ") + tmp_path;
+        return false;
+    }
+
+    const char* base = reinterpret_cast<const char*>(mem_header);
+    bool ok = write_all(fd, &ckpt, sizeof(ckpt)) && write_all(fd, base, ckpt.node_bytes)
+        && (!ckpt.arena || write_all(fd, base + ckpt.arena, ckpt.arena_bytes)) && fsync(fd) == 0;
+    ::close(fd);
+    if(!ok || rename(tmp_path.c_str(), ckpt_path) != 0)
+    {
+        err_msg_ = "write checkpoint failed";
+        return false;
+    }
+
+    // rename落盘之后才能清空日志
+    if(!sl_sync_dir(ckpt_path))
+    {
+        err_msg_ = "sync checkpoint dir failed";
+        return false;
+    }
+
+    if(fd_ < 0) return true;
+
+    // 检查点已经包含了所有记录，换成只有文件头的新日志，缓冲中还没写入的记录也不用再写
+    // 在这之前崩溃时留下的旧日志比检查点旧，recover按序号跳过其中的记录，open再换成新日志
+    std::unique_lock<std::mutex> guard(mutex_);
+    while(committing_)
+        cond_.wait(guard);
+
+    fd = reset_log(log_path_);
+    if(fd < 0)
+    {// 继续使用旧日志，其中的记录都已包含在检查点中，恢复时按序号跳过
+        err_msg_ = "reset wal file failed";
+        return false;
+    }
+
+    // rename之后日志路径上已经是新日志，之后的帧都要写到新日志中
+    ::close(fd_);
+    fd_ = fd;
+    buffer_.clear();
+    io_err_ = false;
+    durable_lsn_ = lsn_;
+
+    if(!sl_sync_dir(log_path_.c_str()))
+    {// 崩溃后日志路径上可能还是旧日志，写到新日志中的帧会丢，不再接受修改，直到下一次checkpoint成功
+        io_err_ = true;
+        err_msg_ = "sync wal dir failed";
+        return false;
+    }
+
+    return true;
+}
+
+#endif
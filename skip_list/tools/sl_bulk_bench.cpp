@@ -0,0 +1,92 @@
+/*
+ * File        : sl_bulk_bench.cpp
+ * Created Date: 2026-10-19 04:26:13
+ * Author      : philma
+ * Desc        : 批量插入的对比：先随机插入n个元素建表，再把不同大小的无序批次分别用逐个insert和insert_bulk插入，
+ *               输出两者的耗时和insert_bulk选择的路径（finger为逐个插入，merge为归并），用于检查代价模型的分界点
+ *               编译: g++ -O2 -std=c++11 -pthread -I.. sl_bulk_bench.cpp -o sl_bulk_bench
+ *               用法: sl_bulk_bench [n=1000000] [thread_num=4]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <chrono>
+#include "skip_list.h"
+
+typedef std::chrono::steady_clock Clock;
+typedef SkipList<uint64_t> List;
+
+static double ms_since(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static uint64_t next_key(uint64_t& seed)
+{
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return seed >> 16;
+}
+
+// 按n个元素建表后插入batch，返回耗时（毫秒）；bulk为false时逐个insert
+static double run(uint32_t n, const std::vector<uint64_t>& batch, bool bulk, int thread_num, SLBulkPath& path)
+{
+    List sl;
+    size_t mem_size = sl.max_mem_size(n + batch.size());
+    void* mem = malloc(mem_size);
+    if(!mem || !sl.init(mem, mem_size, n + batch.size()))
+    {
+        fprintf(stderr, "init failed\n");
+        exit(1);
+    }
+
+    uint64_t seed = 1;
+    for(uint32_t i = 0; i < n; ++i)
+        sl.insert(next_key(seed));
+
+    Clock::time_point start = Clock::now();
+    path = SL_BULK_NONE;
+    if(bulk)
+        sl.insert_bulk(batch.begin(), batch.end(), thread_num, &path);
+    else
+    {
+        for(size_t i = 0; i < batch.size(); ++i)
+            sl.insert(batch[i]);
+    }
+    double cost = ms_since(start);
+
+    if(sl.length() != n + batch.size())
+    {
+        fprintf(stderr, "length mismatch: %u\n", sl.length());
+        exit(1);
+    }
+
+    free(mem);
+    return cost;
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t n = argc > 1 ? atoi(argv[1]) : 1000000;
+    int thread_num = argc > 2 ? atoi(argv[2]) : 4;
+
+    static const char* path_name[] = {"none", "finger", "merge"};
+    static const double ratios[] = {0.001, 0.01, 0.05, 0.1, 0.2, 0.5, 1.0};
+
+    printf("n: %u, thread_num: %d\n", n, thread_num);
+    printf("%10s %14s %14s %8s\n", "batch", "insert(ms)", "bulk(ms)", "path");
+    for(size_t r = 0; r < sizeof(ratios) / sizeof(ratios[0]); ++r)
+    {
+        std::vector<uint64_t> batch(static_cast<size_t>(n * ratios[r]));
+        uint64_t seed = 2;
+        for(size_t i = 0; i < batch.size(); ++i)
+            batch[i] = next_key(seed);
+
+        SLBulkPath path;
+        double insert_cost = run(n, batch, false, thread_num, path);
+        double bulk_cost = run(n, batch, true, thread_num, path);
+        printf("%10zu %14.1f %14.1f %8s\n", batch.size(), insert_cost, bulk_cost, path_name[path]);
+    }
+
+    return 0;
+}
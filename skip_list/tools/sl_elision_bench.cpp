@@ -0,0 +1,146 @@
+/*
+ * File        : sl_elision_bench.cpp
+ * Created Date: 2026-10-18 20:06:31
+ * Author      : philma
+ * Desc        : ElidedSkipList在只加锁和锁消除两种方式下，不同线程数、不同读写比例的吞吐对比
+ *               每个线程在[0, key_range)内随机选键，按读比例执行get_index，其余一半插入一半删除
+ *               第二组只做插入删除，每个线程只改自己的键区间，表不带跨度(HAS_SPAN=false)，
+ *               用来看互不相交的写操作在锁消除下能否并行
+ *               编译: g++ -O2 -std=c++11 -pthread -I.. sl_elision_bench.cpp -o sl_elision_bench
+ *               用法: sl_elision_bench [max_threads=16] [ops_per_thread=200000] [read_pct=90] [key_range=100000]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include "skip_list_elision.h"
+
+typedef ElidedSkipList<uint64_t> List;
+
+// 不带跨度的表，插入删除基本只改前驱节点；插到表尾或者表的层数变化时仍要改表头，见skip_list_elision.h
+struct NoSpanTraits : SLDefaultTraits
+{
+    static const bool HAS_SPAN = false;
+};
+typedef ElidedSkipList<uint64_t, std::less<uint64_t>, NoSpanTraits> NoSpanList;
+
+// 带跨度的表按位置索引读，不带跨度的表按元素查找
+static void read(List& sl, uint64_t key) { sl.get_index(key); }
+
+static void read(NoSpanList& sl, uint64_t key)
+{
+    uint64_t out = 0;
+    sl.find(key, out);
+}
+
+struct Result
+{
+    double mops;
+    List::Stats stats;
+};
+
+// disjoint为true时只做插入删除，线程t的键落在[t * key_range, (t + 1) * key_range)
+template<typename L>
+static Result run(int thread_num, bool elision, uint32_t ops, uint32_t read_pct, uint32_t key_range, bool disjoint)
+{
+    L sl;
+    uint32_t max_len = key_range + thread_num * ops;
+    std::vector<char> mem(sl.max_mem_size(max_len));
+    if(!sl.init(&mem[0], mem.size(), max_len))
+    {
+        fprintf(stderr, "init failed: %s\n", sl.err_msg().c_str());
+        exit(1);
+    }
+    sl.set_elision(elision);
+
+    // 预先填入一半的键
+    for(uint32_t i = 0; i < key_range; i += 2)
+    {
+        if(!disjoint)
+            sl.insert(i);
+        else
+        {
+            for(int t = 0; t < thread_num; ++t)
+                sl.insert(static_cast<uint64_t>(t) * key_range + i);
+        }
+    }
+
+    Result result = {0, {0, 0, 0}};
+    std::mutex result_mutex;
+    std::vector<std::thread> threads;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(int t = 0; t < thread_num; ++t)
+    {
+        threads.emplace_back([&, t]() {
+            L::thread_stats() = typename L::Stats();
+            uint64_t seed = t * 0x9E3779B97F4A7C15ULL + 1;
+            for(uint32_t i = 0; i < ops; ++i)
+            {
+                seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+                uint64_t key = (seed >> 33) % key_range;
+                uint32_t dice = (seed >> 13) % 100;
+                if(disjoint)
+                {
+                    key += static_cast<uint64_t>(t) * key_range;
+                    if(dice & 1) sl.insert(key);
+                    else sl.erase(key);
+                }
+                else if(dice < read_pct) read(sl, key);
+                else if(dice & 1) sl.insert(key);
+                else sl.erase(key);
+            }
+
+            std::lock_guard<std::mutex> guard(result_mutex);
+            result.stats.commit += L::thread_stats().commit;
+            result.stats.abort += L::thread_stats().abort;
+            result.stats.fallback += L::thread_stats().fallback;
+        });
+    }
+
+    for(size_t t = 0; t < threads.size(); ++t)
+        threads[t].join();
+
+    std::chrono::duration<double> cost = std::chrono::steady_clock::now() - start;
+    result.mops = thread_num * static_cast<double>(ops) / cost.count() / 1e6;
+
+    return result;
+}
+
+static void print(int thread_num, const Result& lock, const Result& elide)
+{
+    printf("%8d %14.3f %14.3f %12lu %12lu %12lu\n", thread_num, lock.mops, elide.mops,
+        static_cast<unsigned long>(elide.stats.commit), static_cast<unsigned long>(elide.stats.abort),
+        static_cast<unsigned long>(elide.stats.fallback));
+}
+
+int main(int argc, char* argv[])
+{
+    int max_threads = argc > 1 ? atoi(argv[1]) : 16;
+    uint32_t ops = argc > 2 ? atoi(argv[2]) : 200000;
+    uint32_t read_pct = argc > 3 ? atoi(argv[3]) : 90;
+    uint32_t key_range = argc > 4 ? atoi(argv[4]) : 100000;
+
+    printf("rtm: %s, hardware threads: %u, ops per thread: %u, read: %u%%, key range: %u\n",
+        sl_cpu_has_rtm() ? "yes" : "no", std::thread::hardware_concurrency(), ops, read_pct, key_range);
+    printf("%8s %14s %14s %12s %12s %12s\n", "threads", "lock(Mops/s)", "elide(Mops/s)", "commit", "abort", "fallback");
+    for(int thread_num = 1; thread_num <= max_threads; thread_num *= 2)
+    {
+        Result lock = run<List>(thread_num, false, ops, read_pct, key_range, false);
+        Result elide = run<List>(thread_num, true, ops, read_pct, key_range, false);
+        print(thread_num, lock, elide);
+    }
+
+    printf("\ndisjoint updates, no span:\n");
+    printf("%8s %14s %14s %12s %12s %12s\n", "threads", "lock(Mops/s)", "elide(Mops/s)", "commit", "abort", "fallback");
+    for(int thread_num = 1; thread_num <= max_threads; thread_num *= 2)
+    {
+        Result lock = run<NoSpanList>(thread_num, false, ops, read_pct, key_range, true);
+        Result elide = run<NoSpanList>(thread_num, true, ops, read_pct, key_range, true);
+        print(thread_num, lock, elide);
+    }
+
+    return 0;
+}
@@ -0,0 +1,101 @@
+/*
+ * File        : sl_heap_bench.cpp
+ * Created Date: 2026-10-19 03:41:06
+ * Author      : philma
+ * Desc        : HeapSkipList和std::multiset的对比：随机插入、按元素查找、按排名查找、删除，输出每个操作的平均耗时
+ *               HeapSkipList从很小的初始容量开始，插入过程中按块增长
+ *               编译: g++ -O2 -std=c++11 -I.. sl_heap_bench.cpp -o sl_heap_bench
+ *               用法: sl_heap_bench [n=1000000] [init_len=1024]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <set>
+#include <iterator>
+#include <chrono>
+#include "skip_list_heap.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double ns_per_op(Clock::time_point start, uint32_t n)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / n;
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t n = argc > 1 ? atoi(argv[1]) : 1000000;
+    uint32_t init_len = argc > 2 ? atoi(argv[2]) : 1024;
+
+    std::vector<uint64_t> keys(n);
+    uint64_t seed = 1;
+    for(uint32_t i = 0; i < n; ++i)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        keys[i] = seed >> 16;
+    }
+
+    std::vector<uint64_t> probes(keys);
+    for(uint32_t i = n - 1; i > 0; --i)
+        std::swap(probes[i], probes[random() % (i + 1)]);
+
+    HeapSkipList<uint64_t> sl(init_len);
+    if(!sl.err_msg().empty())
+    {
+        fprintf(stderr, "HeapSkipList failed: %s\n", sl.err_msg().c_str());
+        return 1;
+    }
+
+    std::multiset<uint64_t> ms;
+    uint64_t check = 0;
+
+    printf("n: %u, init_len: %u\n", n, init_len);
+    printf("%12s %16s %16s\n", "op(ns)", "HeapSkipList", "std::multiset");
+
+    Clock::time_point start = Clock::now();
+    for(uint32_t i = 0; i < n; ++i)
+        sl.insert(keys[i]);
+    double sl_cost = ns_per_op(start, n);
+
+    start = Clock::now();
+    for(uint32_t i = 0; i < n; ++i)
+        ms.insert(keys[i]);
+    printf("%12s %16.1f %16.1f\n", "insert", sl_cost, ns_per_op(start, n));
+
+    start = Clock::now();
+    for(uint32_t i = 0; i < n; ++i)
+        check += sl.find(probes[i]) != sl.end();
+    sl_cost = ns_per_op(start, n);
+
+    start = Clock::now();
+    for(uint32_t i = 0; i < n; ++i)
+        check += ms.find(probes[i]) != ms.end();
+    printf("%12s %16.1f %16.1f\n", "find", sl_cost, ns_per_op(start, n));
+
+    // multiset没有按排名的索引，只能从头数，只测少量
+    uint32_t rank_n = n < 100 ? n : 100;
+    start = Clock::now();
+    for(uint32_t i = 0; i < rank_n; ++i)
+        check += *sl.find(static_cast<uint32_t>(random() % n + 1));
+    sl_cost = ns_per_op(start, rank_n);
+
+    start = Clock::now();
+    for(uint32_t i = 0; i < rank_n; ++i)
+        check += *std::next(ms.begin(), random() % n);
+    printf("%12s %16.1f %16.1f\n", "find(rank)", sl_cost, ns_per_op(start, rank_n));
+
+    start = Clock::now();
+    for(uint32_t i = 0; i < n; ++i)
+        sl.erase(probes[i]);
+    sl_cost = ns_per_op(start, n);
+
+    start = Clock::now();
+    for(uint32_t i = 0; i < n; ++i)
+        ms.erase(probes[i]);
+    printf("%12s %16.1f %16.1f\n", "erase", sl_cost, ns_per_op(start, n));
+
+    printf("mapped: %.1f MB, check: %lu\n", sl.capacity_bytes() / 1048576.0, static_cast<unsigned long>(check));
+
+    return 0;
+}
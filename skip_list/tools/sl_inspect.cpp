@@ -0,0 +1,205 @@
+/*
+ * File        : sl_inspect.cpp
+ * Created Date: 2026-10-19 02:05:18
+ * Author      : philma
+ * Desc        : 运维用的跳跃表查看工具，以只读方式映射共享内存或文件中的跳跃表并挂接（init的is_raw=false），
+ *               打印内存头、层数分布、空闲节点和碎片率，再对线上结构做抽样查找，输出各操作的延迟分位
+ *               映射是PROT_READ的，不会改动区域；属主进程同时在修改时统计和抽样结果只是近似值
+ *               Traits::TRACK_ACCESS为true时查找会累加节点的命中次数，只读映射上会触发SIGSEGV，
+ *               此时改用MAP_PRIVATE的可写映射，命中次数写在本进程的私有页上，区域和属主的统计都不受影响，
+ *               被写过的页不再跟随属主的修改
+ *               Traits::HAS_SPAN为false时没有位置索引，抽样改为遍历一遍随机取元素，只统计find的延迟
+ *               编译: g++ -O2 -std=c++11 -I.. sl_inspect.cpp -o sl_inspect
+ *               元素类型、比较函数和Traits须与属主进程一致，默认是uint64_t、std::less和SLDefaultTraits，
+ *               分别用 -DSL_INSPECT_ELEMENT_TYPE=xxx -DSL_INSPECT_COMPARE=xxx -DSL_INSPECT_TRAITS=xxx 指定，
+ *               自定义的类型放在头文件里用 -include xxx.h 引入；分段(SEGMENTED)的表没有段提供者，挂接会失败
+ *               用法: sl_inspect region_path [probe_num=10000]    （如 /dev/shm/xxx）
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "skip_list.h"
+
+#ifndef SL_INSPECT_ELEMENT_TYPE
+#define SL_INSPECT_ELEMENT_TYPE uint64_t
+#endif
+
+typedef SL_INSPECT_ELEMENT_TYPE Element;
+
+#ifndef SL_INSPECT_COMPARE
+#define SL_INSPECT_COMPARE std::less<Element>
+#endif
+
+#ifndef SL_INSPECT_TRAITS
+#define SL_INSPECT_TRAITS SLDefaultTraits
+#endif
+
+typedef SL_INSPECT_TRAITS Traits;
+typedef SkipList<Element, SL_INSPECT_COMPARE, Traits> List;
+
+static void print_stats(const List& sl)
+{
+    List::Stats stats;
+    sl.stats(stats);
+
+    printf("mem_size:        %zu\n", stats.mem_size);
+    printf("header_size:     %zu\n", stats.header_size);
+    printf("node_size:       %zu\n", stats.node_size);
+    printf("alloc_size:      %zu (%.1f%%)\n", stats.alloc_size, 100.0 * stats.alloc_size / stats.mem_size);
+    printf("version:         %lu\n", static_cast<unsigned long>(stats.version));
+    printf("length:          %u\n", stats.length);
+    printf("level_num:       %d\n", stats.level_num);
+    printf("free_num:        %u\n", stats.free_num);
+    printf("fragmentation:   %.2f%%\n", 100.0 * stats.fragmentation);
+    if(stats.arena_size)
+    {
+        printf("arena_size:      %zu\n", stats.arena_size);
+        printf("arena_alloc:     %zu\n", stats.arena_alloc_size);
+        printf("arena_used:      %zu (%.1f%% of carved)\n", stats.arena_used_size,
+            stats.arena_alloc_size ? 100.0 * stats.arena_used_size / stats.arena_alloc_size : 0.0);
+    }
+
+    printf("\n%6s %12s %12s\n", "level", "nodes", "height=lvl");
+    for(int i = 0; i < stats.level_num; ++i)
+    {
+        uint32_t next = i + 1 < stats.level_num ? stats.level_count[i + 1] : 0;
+        printf("%6d %12u %12u\n", i + 1, stats.level_count[i], stats.level_count[i] - std::min(next, stats.level_count[i]));
+    }
+}
+
+static void print_latency(const char* name, std::vector<double>& cost)
+{
+    if(cost.empty()) return;
+
+    std::sort(cost.begin(), cost.end());
+    printf("%12s %10.0f %10.0f %10.0f %10.0f\n", name, cost[cost.size() / 2], cost[cost.size() * 9 / 10],
+        cost[cost.size() * 99 / 100], cost.back());
+}
+
+// 抽样查找：随机取位置索引，find(index)取出元素，再用该元素做find和get_index
+// 两个probe写成模板，只实例化和HAS_SPAN对应的那个，另一个用到的接口在不带跨度的表上会编译失败
+template<typename L>
+static void probe(const L& sl, uint32_t probe_num, std::true_type)
+{
+    std::vector<double> find_index_cost, find_cost, get_index_cost;
+    uint32_t miss = 0;
+    for(uint32_t i = 0; i < probe_num; ++i)
+    {
+        uint32_t length = sl.length();
+        if(!length) break;
+
+        uint32_t index = random() % length + 1;
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        typename L::Iterator it = sl.find(index);
+        std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+        find_index_cost.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count());
+        if(it == sl.end())
+        {// 属主进程刚刚删除了元素
+            ++miss;
+            continue;
+        }
+
+        Element element = *it;
+        t0 = std::chrono::steady_clock::now();
+        bool found = sl.find(element) != sl.end();
+        t1 = std::chrono::steady_clock::now();
+        find_cost.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count());
+
+        t0 = std::chrono::steady_clock::now();
+        uint32_t rank = sl.get_index(element);
+        t1 = std::chrono::steady_clock::now();
+        get_index_cost.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count());
+
+        if(!found || !rank) ++miss;
+    }
+
+    printf("\nprobe: %u samples, %u missed by concurrent changes\n", probe_num, miss);
+    printf("%12s %10s %10s %10s %10s\n", "op(ns)", "p50", "p90", "p99", "max");
+    print_latency("find_index", find_index_cost);
+    print_latency("find", find_cost);
+    print_latency("get_index", get_index_cost);
+}
+
+// 没有跨度时：沿第0层走一遍，蓄水池抽样取probe_num个元素，再逐个find
+template<typename L>
+static void probe(const L& sl, uint32_t probe_num, std::false_type)
+{
+    std::vector<Element> samples;
+    uint64_t seen = 0;
+    for(typename L::Iterator it = sl.begin(); it != sl.end() && seen < sl.length() * 2ULL + 1; ++it, ++seen)
+    {
+        if(samples.size() < probe_num)
+            samples.push_back(*it);
+        else
+        {
+            uint64_t pos = static_cast<uint64_t>(random()) % (seen + 1);
+            if(pos < probe_num) samples[pos] = *it;
+        }
+    }
+
+    std::vector<double> find_cost;
+    uint32_t miss = 0;
+    for(size_t i = 0; i < samples.size(); ++i)
+    {
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        bool found = sl.find(samples[i]) != sl.end();
+        std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+        find_cost.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count());
+        if(!found) ++miss;
+    }
+
+    printf("\nprobe: %zu samples, %u missed by concurrent changes\n", samples.size(), miss);
+    printf("%12s %10s %10s %10s %10s\n", "op(ns)", "p50", "p90", "p99", "max");
+    print_latency("find", find_cost);
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2)
+    {
+        fprintf(stderr, "usage: %s region_path [probe_num=10000]\n", argv[0]);
+        return 1;
+    }
+
+    uint32_t probe_num = argc > 2 ? atoi(argv[2]) : 10000;
+
+    int fd = open(argv[1], O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0)
+    {
+        fprintf(stderr, "open %s failed\n", argv[1]);
+        return 1;
+    }
+
+    // 记录命中次数的表查找时要写节点，用私有的写时复制映射，写不会落到区域上
+    size_t mem_size = st.st_size;
+    void* mem = Traits::TRACK_ACCESS ? mmap(nullptr, mem_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0)
+        : mmap(nullptr, mem_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mem == MAP_FAILED)
+    {
+        fprintf(stderr, "mmap %s failed\n", argv[1]);
+        return 1;
+    }
+
+    // 挂接只校验内存头，不写区域
+    List sl;
+    if(!sl.init(mem, mem_size, 0, false))
+    {
+        fprintf(stderr, "attach failed: %s\n", sl.err_msg().c_str());
+        return 1;
+    }
+
+    print_stats(sl);
+    probe(sl, probe_num, std::integral_constant<bool, Traits::HAS_SPAN>());
+
+    munmap(mem, mem_size);
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * File        : sl_key_cache_bench.cpp
+ * Created Date: 2026-10-18 20:41:05
+ * Author      : philma
+ * Desc        : 对比普通节点和CACHE_FORWARD_KEY节点在随机查找时的耗时和每次查找的缓存未命中数
+ *               缓存未命中通过perf_event_open读取硬件计数器，没有权限（perf_event_paranoid）或在虚拟机里时显示n/a
+ *               编译: g++ -O2 -std=c++11 -I.. sl_key_cache_bench.cpp -o sl_key_cache_bench
+ *               用法: sl_key_cache_bench [list_len=1000000] [lookups=2000000]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <chrono>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "skip_list.h"
+
+// 一个硬件计数器，打开失败时读数为-1
+class PerfCounter
+{
+public:
+    PerfCounter(uint32_t type, uint64_t config)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd_ = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    ~PerfCounter() { if(fd_ >= 0) close(fd_); }
+
+    void start()
+    {
+        if(fd_ < 0) return;
+        ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    int64_t stop()
+    {
+        if(fd_ < 0) return -1;
+
+        ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+        int64_t count = 0;
+        if(read(fd_, &count, sizeof(count)) != sizeof(count)) return -1;
+
+        return count;
+    }
+
+private:
+    int fd_;
+};
+
+static void print_per_lookup(int64_t count, uint32_t lookups)
+{
+    if(count < 0) printf(" %14s", "n/a");
+    else printf(" %14.2f", static_cast<double>(count) / lookups);
+}
+
+template<typename Traits>
+static void run(const char* name, const std::vector<uint64_t>& keys, const std::vector<uint64_t>& queries)
+{
+    typedef SkipList<uint64_t, std::less<uint64_t>, Traits> List;
+    List sl;
+    std::vector<char> mem(sl.max_mem_size(keys.size()));
+    if(!sl.init(&mem[0], mem.size(), keys.size()))
+    {
+        fprintf(stderr, "init failed: %s\n", sl.err_msg().c_str());
+        exit(1);
+    }
+
+    for(size_t i = 0; i < keys.size(); ++i)
+        sl.insert(keys[i]);
+
+    PerfCounter l1d(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    PerfCounter llc(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+
+    uint64_t checksum = 0;
+    l1d.start();
+    llc.start();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < queries.size(); ++i)
+        checksum += sl.get_index(queries[i]);
+    std::chrono::duration<double> cost = std::chrono::steady_clock::now() - start;
+    int64_t l1d_miss = l1d.stop();
+    int64_t llc_miss = llc.stop();
+
+    printf("%-12s %10zu %12.1f", name, sl.max_mem_size(keys.size()) >> 20, cost.count() * 1e9 / queries.size());
+    print_per_lookup(l1d_miss, queries.size());
+    print_per_lookup(llc_miss, queries.size());
+    printf(" %20lu\n", static_cast<unsigned long>(checksum));
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t list_len = argc > 1 ? atoi(argv[1]) : 1000000;
+    uint32_t lookups = argc > 2 ? atoi(argv[2]) : 2000000;
+
+    std::vector<uint64_t> keys(list_len);
+    for(uint32_t i = 0; i < list_len; ++i)
+        keys[i] = (static_cast<uint64_t>(random()) << 31) | random();
+
+    // 一半查找命中，一半查找不存在的键
+    std::vector<uint64_t> queries(lookups);
+    for(uint32_t i = 0; i < lookups; ++i)
+        queries[i] = (i & 1) ? keys[random() % list_len] : ((static_cast<uint64_t>(random()) << 31) | random());
+
+    printf("%-12s %10s %12s %14s %14s %20s\n", "layout", "mem(MB)", "ns/lookup", "L1D miss/op", "LLC miss/op", "checksum");
+    run<SLDefaultTraits>("plain", keys, queries);
+    run<SLCacheKeyTraits>("cache_key", keys, queries);
+
+    return 0;
+}
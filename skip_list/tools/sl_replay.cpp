@@ -0,0 +1,214 @@
+/*
+ * File        : sl_replay.cpp
+ * Created Date: 2026-10-18 10:40:25
+ * Author      : philma
+ * Desc        : 回放SkipListTracer记录的操作轨迹，分别灌入SkipList和其他容器，输出吞吐和各操作的延迟分位
+ *               吞吐按整段回放计时，不含逐条计时的开销；延迟分位另外单独回放一遍逐条计时，包含一次取时钟的开销
+ *               编译: g++ -O2 -std=c++11 -I.. sl_replay.cpp -o sl_replay
+ *               元素类型默认是uint64_t，和记录时不一致的话用 -DSL_REPLAY_ELEMENT_TYPE=xxx 指定
+ *               用法: sl_replay trace_file [repeat]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <set>
+#include <iterator>
+#include <algorithm>
+#include <chrono>
+#include "skip_list_trace.h"
+
+#ifndef SL_REPLAY_ELEMENT_TYPE
+#define SL_REPLAY_ELEMENT_TYPE uint64_t
+#endif
+
+typedef SL_REPLAY_ELEMENT_TYPE Element;
+
+static const int OP_NUM = SL_TRACE_GET_INDEX + 1;
+static const char* OP_NAMES[OP_NUM] = {"", "insert", "erase", "find", "find_index", "get_index"};
+
+// 回放目标：基于连续内存的SkipList
+class SkipListTarget
+{
+public:
+    const char* name() const { return "skip_list"; }
+
+    bool init(uint32_t max_len)
+    {
+        size_t mem_size = sl_.max_mem_size(max_len);
+        mem_.resize(mem_size);
+        if(!sl_.init(&mem_[0], mem_size, max_len))
+        {
+            fprintf(stderr, "skip list init failed: %s\n", sl_.err_msg().c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+    uintptr_t apply(const SLTraceRecord<Element>& rec)
+    {
+        switch(rec.op)
+        {
+        case SL_TRACE_INSERT: return sl_.insert(rec.element);
+        case SL_TRACE_ERASE: return sl_.erase(rec.element);
+        case SL_TRACE_FIND: return sl_.find(rec.element) != sl_.end();
+        case SL_TRACE_FIND_INDEX: return sl_.find(rec.index) != sl_.end();
+        case SL_TRACE_GET_INDEX: return sl_.get_index(rec.element);
+        }
+
+        return 0;
+    }
+
+private:
+    std::vector<char> mem_;
+    SkipList<Element> sl_;
+};
+
+// 回放目标：std::multiset，位置相关的操作只能线性遍历，仅作参照
+class MultisetTarget
+{
+public:
+    const char* name() const { return "std::multiset"; }
+
+    bool init(uint32_t)
+    {
+        set_.clear();
+        return true;
+    }
+
+    uintptr_t apply(const SLTraceRecord<Element>& rec)
+    {
+        switch(rec.op)
+        {
+        case SL_TRACE_INSERT:
+            set_.insert(rec.element);
+            return 1;
+        case SL_TRACE_ERASE:
+            return set_.erase(rec.element);
+        case SL_TRACE_FIND:
+            return set_.find(rec.element) != set_.end();
+        case SL_TRACE_FIND_INDEX:
+            if(rec.index == 0 || rec.index > set_.size()) return 0;
+            return std::next(set_.begin(), rec.index - 1) != set_.end();
+        case SL_TRACE_GET_INDEX:
+        {
+            std::multiset<Element>::iterator it = set_.lower_bound(rec.element);
+            if(it == set_.end() || *it != rec.element) return 0;
+            return std::distance(set_.begin(), it) + 1;
+        }
+        }
+
+        return 0;
+    }
+
+private:
+    std::multiset<Element> set_;
+};
+
+static uint64_t percentile(const std::vector<uint64_t>& sorted, double p)
+{
+    if(sorted.empty()) return 0;
+
+    size_t pos = static_cast<size_t>(p * (sorted.size() - 1));
+    return sorted[pos];
+}
+
+template<typename Target>
+static bool replay(Target& target, const std::vector<SLTraceRecord<Element>>& records, uint32_t max_len, int repeat)
+{
+    std::vector<uint64_t> latency[OP_NUM];
+    uint64_t total_ns = 0;
+    uintptr_t sink = 0;
+
+    // 吞吐：每轮整段计时
+    for(int r = 0; r < repeat; ++r)
+    {
+        if(!target.init(max_len)) return false;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < records.size(); ++i)
+            sink += target.apply(records[i]);
+        std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+
+        total_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+    }
+
+    // 延迟分布：再回放一轮，逐条计时
+    if(!target.init(max_len)) return false;
+
+    for(size_t i = 0; i < records.size(); ++i)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        sink += target.apply(records[i]);
+        std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+
+        latency[records[i].op].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+    }
+
+    size_t op_count = records.size() * repeat;
+    printf("[%s] ops: %zu, total: %.3f ms, throughput: %.0f ops/s (checksum %lu)\n",
+        target.name(), op_count, total_ns / 1e6,
+        total_ns ? op_count * 1e9 / total_ns : 0.0, static_cast<unsigned long>(sink));
+    printf("  %-10s %10s %8s %8s %8s %8s %8s (ns)\n", "op", "count", "p50", "p90", "p99", "p99.9", "max");
+    for(int op = SL_TRACE_INSERT; op < OP_NUM; ++op)
+    {
+        std::vector<uint64_t>& lat = latency[op];
+        if(lat.empty()) continue;
+
+        std::sort(lat.begin(), lat.end());
+        printf("  %-10s %10zu %8lu %8lu %8lu %8lu %8lu\n", OP_NAMES[op], lat.size(),
+            static_cast<unsigned long>(percentile(lat, 0.5)),
+            static_cast<unsigned long>(percentile(lat, 0.9)),
+            static_cast<unsigned long>(percentile(lat, 0.99)),
+            static_cast<unsigned long>(percentile(lat, 0.999)),
+            static_cast<unsigned long>(lat.back()));
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2)
+    {
+        fprintf(stderr, "usage: %s trace_file [repeat]\n", argv[0]);
+        return 1;
+    }
+
+    int repeat = argc > 2 ? atoi(argv[2]) : 1;
+    if(repeat <= 0) repeat = 1;
+
+    SLTraceReader<Element> reader;
+    if(!reader.open(argv[1]))
+    {
+        fprintf(stderr, "%s\n", reader.err_msg().c_str());
+        return 1;
+    }
+
+    // 先把轨迹全部读入内存，避免回放时的文件IO干扰计时
+    std::vector<SLTraceRecord<Element>> records;
+    SLTraceRecord<Element> rec;
+    uint32_t insert_count = 0;
+    while(reader.next(rec))
+    {
+        records.push_back(rec);
+        if(rec.op == SL_TRACE_INSERT) ++insert_count;
+    }
+
+    if(!reader.err_msg().empty())
+    {
+        fprintf(stderr, "%s\n", reader.err_msg().c_str());
+        return 1;
+    }
+
+    printf("trace: %s, records: %zu, inserts: %u\n", argv[1], records.size(), insert_count);
+
+    // 轨迹从空表开始记录，插入次数就是表长度的上限
+    SkipListTarget skip_list_target;
+    MultisetTarget multiset_target;
+    if(!replay(skip_list_target, records, insert_count, repeat)) return 1;
+    if(!replay(multiset_target, records, insert_count, repeat)) return 1;
+
+    return 0;
+}
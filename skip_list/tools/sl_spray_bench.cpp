@@ -0,0 +1,96 @@
+/*
+ * File        : sl_spray_bench.cpp
+ * Created Date: 2026-10-18 17:12:30
+ * Author      : philma
+ * Desc        : ConcurrentSkipListPQ的严格出队(delete_min)和松弛出队(spray_pop)在不同线程数下的吞吐对比
+ *               每个线程交替插入随机元素和出队，队列预先填充一定数量的元素
+ *               插入和出队一一对应，同时存在的节点不超过prefill加上每个线程少量的余量，内存按此申请而不是按总操作数
+ *               编译: g++ -O2 -std=c++11 -pthread -I.. sl_spray_bench.cpp -o sl_spray_bench
+ *               用法: sl_spray_bench [max_threads=64] [ops_per_thread=200000] [prefill=100000]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include "concurrent_skip_list_pq.h"
+
+typedef ConcurrentSkipListPQ<uint64_t> PQ;
+
+// 每个线程预留的节点数：出队落后于插入（队列暂时被抢空、线程被切走时纪元推进不了导致回收滞后）时的余量
+static const uint32_t THREAD_SLACK = 4096;
+
+static double run(int thread_num, bool spray, uint32_t ops, uint32_t prefill)
+{
+    PQ pq;
+    uint32_t max_len = prefill + thread_num * THREAD_SLACK;
+    std::vector<char> mem(pq.max_mem_size(max_len));
+    if(!pq.init(&mem[0], mem.size(), max_len))
+    {
+        fprintf(stderr, "init failed: %s\n", pq.err_msg().c_str());
+        exit(1);
+    }
+
+    int tid = pq.attach_thread();
+    for(uint32_t i = 0; i < prefill; ++i)
+        pq.insert(random(), tid);
+    pq.detach_thread(tid);
+
+    std::atomic<uint64_t> insert_fail(0);
+    std::vector<std::thread> threads;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(int t = 0; t < thread_num; ++t)
+    {
+        threads.emplace_back([&pq, &insert_fail, t, thread_num, spray, ops]() {
+            int tid = pq.attach_thread();
+            uint64_t seed = t * 0x9E3779B97F4A7C15ULL + 1;
+            uint64_t element = 0;
+            for(uint32_t i = 0; i < ops; ++i)
+            {
+                if(i & 1)
+                {
+                    if(spray) pq.spray_pop(element, tid, thread_num);
+                    else pq.delete_min(element, tid);
+                }
+                else
+                {
+                    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+                    if(!pq.insert(seed >> 33, tid)) insert_fail.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            pq.detach_thread(tid);
+        });
+    }
+
+    for(size_t t = 0; t < threads.size(); ++t)
+        threads[t].join();
+
+    std::chrono::duration<double> cost = std::chrono::steady_clock::now() - start;
+    if(insert_fail.load())
+        fprintf(stderr, "threads %d: %llu inserts failed, region too small\n", thread_num,
+            static_cast<unsigned long long>(insert_fail.load()));
+
+    return thread_num * static_cast<double>(ops) / cost.count() / 1e6;
+}
+
+int main(int argc, char* argv[])
+{
+    int max_threads = argc > 1 ? atoi(argv[1]) : 64;
+    uint32_t ops = argc > 2 ? atoi(argv[2]) : 200000;
+    uint32_t prefill = argc > 3 ? atoi(argv[3]) : 100000;
+    if(max_threads > PQ::MAX_THREAD_NUM) max_threads = PQ::MAX_THREAD_NUM;
+
+    printf("hardware threads: %u, ops per thread: %u, prefill: %u\n",
+        std::thread::hardware_concurrency(), ops, prefill);
+    printf("%8s %16s %16s\n", "threads", "strict(Mops/s)", "spray(Mops/s)");
+    for(int thread_num = 1; thread_num <= max_threads; thread_num *= 2)
+    {
+        double strict = run(thread_num, false, ops, prefill);
+        double spray = run(thread_num, true, ops, prefill);
+        printf("%8d %16.3f %16.3f\n", thread_num, strict, spray);
+    }
+
+    return 0;
+}